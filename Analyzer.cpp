@@ -0,0 +1,604 @@
+#include "Analyzer.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <set>
+
+namespace
+{
+using Ranges = ProgramAnalysis::Ranges;
+
+// Explorations before the analysis gives up looking for a stable set of
+// written words.
+constexpr int maxPasses = 32;
+// Times the relative base range at one address may grow before it is
+// treated as unbounded.
+constexpr int maxWidenings = 8;
+
+constexpr ProgramValue maxValue = std::numeric_limits<ProgramValue>::max();
+
+struct Range
+{
+	ProgramValue m_first{};
+	ProgramValue m_last{};
+	bool         m_unbounded{};
+
+	bool
+	operator==(const Range&) const = default;
+};
+
+constexpr Range unbounded{0, 0, true};
+
+Range
+shifted(Range range, ProgramValue by)
+{
+	if (range.m_unbounded || __builtin_add_overflow(range.m_first, by, &range.m_first) ||
+	    __builtin_add_overflow(range.m_last, by, &range.m_last))
+	{
+		return unbounded;
+	}
+	return range;
+}
+
+Range
+joined(Range lhs, Range rhs)
+{
+	if (lhs.m_unbounded || rhs.m_unbounded)
+	{
+		return unbounded;
+	}
+	return Range{std::min(lhs.m_first, rhs.m_first), std::max(lhs.m_last, rhs.m_last)};
+}
+
+std::optional<ProgramValue>
+single(Range range)
+{
+	if (range.m_unbounded || range.m_first != range.m_last)
+	{
+		return {};
+	}
+	return range.m_first;
+}
+
+void
+normalize(Ranges& ranges)
+{
+	std::sort(ranges.begin(), ranges.end());
+	Ranges merged;
+	for (const auto& range : ranges)
+	{
+		if (!merged.empty() && (merged.back().second == maxValue ||
+		                        range.first <= merged.back().second + 1))
+		{
+			merged.back().second = std::max(merged.back().second, range.second);
+		}
+		else
+		{
+			merged.push_back(range);
+		}
+	}
+	ranges = std::move(merged);
+}
+
+// The merged range holding address, or end() if none does.
+Ranges::const_iterator
+find(const Ranges& ranges, ProgramValue address)
+{
+	auto next = std::upper_bound(ranges.begin(), ranges.end(),
+	                             std::make_pair(address, maxValue));
+	if (next == ranges.begin() || std::prev(next)->second < address)
+	{
+		return ranges.end();
+	}
+	return std::prev(next);
+}
+
+bool
+contains(const Ranges& ranges, ProgramValue address)
+{
+	return find(ranges, address) != ranges.end();
+}
+
+bool
+covers(const Ranges& outer, const Ranges& inner)
+{
+	return std::all_of(inner.begin(), inner.end(), [&](const auto& range) {
+		auto it = find(outer, range.first);
+		return it != outer.end() && it->second >= range.second;
+	});
+}
+
+bool
+isJump(OpCode opCode)
+{
+	return opCode == OpCode::JumpTrue || opCode == OpCode::JumpFalse;
+}
+
+std::optional<ProgramValue>
+constantValue(const Program& program, const Parameter& parameter,
+              std::optional<ProgramValue> relativeBase,
+              const std::function<bool(ProgramValue)>& neverWritten)
+{
+	ProgramValue address = parameter.m_value;
+	switch (parameter.m_mode)
+	{
+	case ParameterMode::Value:
+		return parameter.m_value;
+	case ParameterMode::Position:
+		break;
+	case ParameterMode::RelativePosition:
+		if (!relativeBase || __builtin_add_overflow(address, *relativeBase, &address))
+		{
+			return {};
+		}
+		break;
+	}
+	if (address < 0 || !neverWritten(address))
+	{
+		return {};
+	}
+	return address < static_cast<ProgramValue>(program.size()) ? program[address] : 0;
+}
+
+// One pass over the reachable code, assuming that words outside the given
+// written ranges keep their image value.
+class Explorer
+{
+public:
+	Explorer(const Program& program, const Ranges& written, bool writesAnywhere)
+	    : m_program(program)
+	    , m_assumedWritten(written)
+	    , m_assumedAnywhere(writesAnywhere)
+	{
+	}
+
+	void run();
+
+	std::map<ProgramValue, ProgramAnalysis::Site> m_sites;
+	std::map<ProgramValue, Range>                 m_relativeBases;
+	std::set<ProgramValue>                        m_unresolved;
+	Ranges                                        m_written;
+	bool                                          m_writesAnywhere{};
+	Ranges                                        m_read;
+	bool                                          m_readsAnywhere{};
+	bool                                          m_complete{true};
+
+private:
+	std::optional<ProgramValue> constant(const Parameter& parameter, Range relativeBase) const;
+	void access(const Parameter& parameter, Range relativeBase, Ranges& ranges, bool& anywhere);
+	void follow(ProgramValue address, Range relativeBase);
+
+	const Program&              m_program;
+	const Ranges&               m_assumedWritten;
+	bool                        m_assumedAnywhere;
+	std::vector<ProgramValue>   m_pending;
+	std::map<ProgramValue, int> m_widenings;
+};
+
+std::optional<ProgramValue>
+Explorer::constant(const Parameter& parameter, Range relativeBase) const
+{
+	return constantValue(m_program, parameter, single(relativeBase), [&](ProgramValue address) {
+		return !m_assumedAnywhere && !contains(m_assumedWritten, address);
+	});
+}
+
+void
+Explorer::access(const Parameter& parameter, Range relativeBase, Ranges& ranges, bool& anywhere)
+{
+	switch (parameter.m_mode)
+	{
+	case ParameterMode::Value:
+		break;
+	case ParameterMode::Position:
+		ranges.emplace_back(parameter.m_value, parameter.m_value);
+		break;
+	case ParameterMode::RelativePosition:
+	{
+		Range range = shifted(relativeBase, parameter.m_value);
+		if (range.m_unbounded)
+		{
+			anywhere = true;
+		}
+		else
+		{
+			ranges.emplace_back(range.m_first, range.m_last);
+		}
+		break;
+	}
+	}
+}
+
+// Queues address for a visit unless it was already seen with a relative
+// base range covering this one.
+void
+Explorer::follow(ProgramValue address, Range relativeBase)
+{
+	auto [it, inserted] = m_relativeBases.try_emplace(address, relativeBase);
+	if (!inserted)
+	{
+		Range merged = joined(it->second, relativeBase);
+		if (merged == it->second)
+		{
+			return;
+		}
+		it->second = ++m_widenings[address] > maxWidenings ? unbounded : merged;
+	}
+	m_pending.push_back(address);
+}
+
+void
+Explorer::run()
+{
+	follow(0, Range{});
+	while (!m_pending.empty())
+	{
+		ProgramValue address = m_pending.back();
+		m_pending.pop_back();
+		Range relativeBase = m_relativeBases[address];
+
+		if (address < 0 || address >= static_cast<ProgramValue>(m_program.size()))
+		{
+			m_complete = false;
+			continue;
+		}
+		Instruction  instruction = decodeInstruction(m_program, address);
+		ProgramValue next        = address + 1 + instruction.m_numParameters;
+		if (!isKnownOpCode(instruction.m_opCode) ||
+		    next > static_cast<ProgramValue>(m_program.size()))
+		{
+			m_complete = false;
+			continue;
+		}
+
+		auto& site          = m_sites[address];
+		site.m_instruction  = instruction;
+		site.m_relativeBase = single(relativeBase);
+		site.m_successors.clear();
+		for (int i = 0; i < instruction.m_numParameters; ++i)
+		{
+			if (writesParameter(instruction.m_opCode, i))
+			{
+				access(instruction.m_parameters[i], relativeBase, m_written, m_writesAnywhere);
+			}
+			else
+			{
+				access(instruction.m_parameters[i], relativeBase, m_read, m_readsAnywhere);
+			}
+		}
+
+		Range nextRelativeBase = relativeBase;
+		switch (instruction.m_opCode)
+		{
+		case OpCode::Halt:
+			break;
+		case OpCode::NudgeRelativeBase:
+		{
+			auto by          = constant(instruction.m_parameters[0], relativeBase);
+			nextRelativeBase = by ? shifted(relativeBase, *by) : unbounded;
+			site.m_successors.push_back(next);
+			break;
+		}
+		case OpCode::JumpTrue:
+		case OpCode::JumpFalse:
+		{
+			auto condition = constant(instruction.m_parameters[0], relativeBase);
+			auto target    = constant(instruction.m_parameters[1], relativeBase);
+			bool taken     = condition && (*condition != 0) == (instruction.m_opCode == OpCode::JumpTrue);
+			if (!condition || !taken)
+			{
+				site.m_successors.push_back(next);
+			}
+			if (!condition || taken)
+			{
+				if (target)
+				{
+					site.m_successors.push_back(*target);
+				}
+				else
+				{
+					m_unresolved.insert(address);
+					m_complete = false;
+				}
+			}
+			break;
+		}
+		default:
+			site.m_successors.push_back(next);
+			break;
+		}
+		for (ProgramValue successor : site.m_successors)
+		{
+			follow(successor, nextRelativeBase);
+		}
+	}
+	normalize(m_written);
+	normalize(m_read);
+}
+
+// Splits the reachable instructions into blocks at jump targets and after
+// jumps.
+std::map<ProgramValue, ProgramAnalysis::BasicBlock>
+findBlocks(const std::map<ProgramValue, ProgramAnalysis::Site>& sites,
+           const std::set<ProgramValue>&                        unresolved)
+{
+	std::set<ProgramValue> leaders{0};
+	for (const auto& [address, site] : sites)
+	{
+		if (isJump(site.m_instruction.m_opCode))
+		{
+			leaders.insert(site.m_successors.begin(), site.m_successors.end());
+		}
+	}
+
+	std::map<ProgramValue, ProgramAnalysis::BasicBlock> blocks;
+	for (ProgramValue leader : leaders)
+	{
+		if (!sites.count(leader))
+		{
+			continue;
+		}
+		auto&        block   = blocks[leader];
+		ProgramValue address = leader;
+		for (;;)
+		{
+			const auto&  site = sites.at(address);
+			ProgramValue next = address + 1 + site.m_instruction.m_numParameters;
+			block.m_end       = next;
+			if (isJump(site.m_instruction.m_opCode) || site.m_successors.empty() ||
+			    leaders.count(next) || !sites.count(next))
+			{
+				block.m_successors = site.m_successors;
+				block.m_indirect   = unresolved.count(address) != 0;
+				break;
+			}
+			address = next;
+		}
+	}
+	return blocks;
+}
+
+void
+markUses(std::vector<ProgramAnalysis::Use>& uses, const Ranges& ranges, bool anywhere)
+{
+	using Use = ProgramAnalysis::Use;
+
+	auto mark = [&](ProgramValue first, ProgramValue last) {
+		first = std::max<ProgramValue>(first, 0);
+		last  = std::min<ProgramValue>(last, static_cast<ProgramValue>(uses.size()) - 1);
+		for (ProgramValue address = first; address <= last; ++address)
+		{
+			uses[address] = uses[address] == Use::Code || uses[address] == Use::CodeAndData
+			                    ? Use::CodeAndData
+			                    : Use::Data;
+		}
+	};
+	if (anywhere)
+	{
+		mark(0, static_cast<ProgramValue>(uses.size()) - 1);
+		return;
+	}
+	for (const auto& [first, last] : ranges)
+	{
+		mark(first, last);
+	}
+}
+
+// Encodes instruction over the words it was decoded from.
+void
+encode(Program& program, ProgramValue address, const Instruction& instruction)
+{
+	ProgramValue word  = static_cast<ProgramValue>(instruction.m_opCode);
+	ProgramValue scale = 100;
+	for (int i = 0; i < instruction.m_numParameters; ++i)
+	{
+		word += scale * static_cast<ProgramValue>(instruction.m_parameters[i].m_mode);
+		scale *= 10;
+		program[address + 1 + i] = instruction.m_parameters[i].m_value;
+	}
+	program[address] = word;
+}
+
+// The result of an arithmetic or comparison instruction, if it fits 32 bits.
+std::optional<ProgramValue>
+fold(OpCode opCode, ProgramValue lhs, ProgramValue rhs)
+{
+	ProgramValue result{};
+	switch (opCode)
+	{
+	case OpCode::Add:
+		if (__builtin_add_overflow(lhs, rhs, &result))
+		{
+			return {};
+		}
+		break;
+	case OpCode::Mult:
+		if (__builtin_mul_overflow(lhs, rhs, &result))
+		{
+			return {};
+		}
+		break;
+	case OpCode::LessThan:
+		result = lhs < rhs;
+		break;
+	case OpCode::Equals:
+		result = lhs == rhs;
+		break;
+	default:
+		return {};
+	}
+	if (static_cast<int32_t>(result) != result)
+	{
+		return {};
+	}
+	return result;
+}
+} // namespace
+
+bool
+ProgramAnalysis::neverWritten(ProgramValue address) const
+{
+	return m_complete && !m_writesAnywhere && !contains(m_written, address);
+}
+
+bool
+ProgramAnalysis::neverRead(ProgramValue address) const
+{
+	return m_complete && !m_readsAnywhere && !contains(m_read, address);
+}
+
+std::optional<ProgramValue>
+ProgramAnalysis::constantOperand(const Program& program, ProgramValue address,
+                                 int parameter) const
+{
+	auto it = m_sites.find(address);
+	if (!m_complete || it == m_sites.end() ||
+	    writesParameter(it->second.m_instruction.m_opCode, parameter))
+	{
+		return {};
+	}
+	return constantValue(program, it->second.m_instruction.m_parameters[parameter],
+	                     it->second.m_relativeBase,
+	                     [this](ProgramValue address) { return neverWritten(address); });
+}
+
+ProgramAnalysis
+analyzeProgram(const Program& program)
+{
+	// Start by assuming nothing is written, and widen the assumption with
+	// the stores each pass finds until a pass finds no new ones.
+	Ranges assumed;
+	bool   assumedAnywhere = false;
+	for (int pass = 0;; ++pass)
+	{
+		Explorer explorer(program, assumed, assumedAnywhere);
+		explorer.run();
+		bool stable = assumedAnywhere ||
+		              (!explorer.m_writesAnywhere && covers(assumed, explorer.m_written));
+		if (!stable && pass + 1 < maxPasses)
+		{
+			assumed.insert(assumed.end(), explorer.m_written.begin(), explorer.m_written.end());
+			normalize(assumed);
+			assumedAnywhere = explorer.m_writesAnywhere;
+			continue;
+		}
+
+		ProgramAnalysis analysis;
+		analysis.m_complete       = stable && explorer.m_complete && !explorer.m_writesAnywhere;
+		analysis.m_written        = std::move(explorer.m_written);
+		analysis.m_writesAnywhere = explorer.m_writesAnywhere;
+		analysis.m_read           = std::move(explorer.m_read);
+		analysis.m_readsAnywhere  = explorer.m_readsAnywhere;
+		analysis.m_blocks         = findBlocks(explorer.m_sites, explorer.m_unresolved);
+		analysis.m_uses.resize(program.size());
+		for (const auto& [address, site] : explorer.m_sites)
+		{
+			for (int i = 0; i <= site.m_instruction.m_numParameters; ++i)
+			{
+				analysis.m_uses[address + i] = ProgramAnalysis::Use::Code;
+				if (contains(analysis.m_written, address + i))
+				{
+					analysis.m_complete = false;
+				}
+			}
+		}
+		markUses(analysis.m_uses, analysis.m_read, analysis.m_readsAnywhere);
+		markUses(analysis.m_uses, analysis.m_written, analysis.m_writesAnywhere);
+		analysis.m_sites = std::move(explorer.m_sites);
+		return analysis;
+	}
+}
+
+OptimizedProgram
+optimizeProgram(const Program& program, const ProgramAnalysis& analysis)
+{
+	OptimizedProgram result;
+	result.m_program = program;
+	if (!analysis.m_complete)
+	{
+		return result;
+	}
+	result.m_immutableCode = true;
+
+	std::vector<int> coverage(program.size());
+	for (const auto& [address, site] : analysis.m_sites)
+	{
+		for (int i = 0; i <= site.m_instruction.m_numParameters; ++i)
+		{
+			++coverage[address + i];
+		}
+	}
+
+	for (const auto& [address, site] : analysis.m_sites)
+	{
+		const Instruction& instruction = site.m_instruction;
+		bool               rewritable  = true;
+		for (int i = 0; i <= instruction.m_numParameters; ++i)
+		{
+			rewritable = rewritable && coverage[address + i] == 1 &&
+			             analysis.neverRead(address + i);
+		}
+		if (!rewritable)
+		{
+			continue;
+		}
+
+		Instruction                                rewritten = instruction;
+		std::array<std::optional<ProgramValue>, 3> constants;
+		for (int i = 0; i < instruction.m_numParameters; ++i)
+		{
+			constants[i] = analysis.constantOperand(program, address, i);
+			if (constants[i] && instruction.m_parameters[i].m_mode != ParameterMode::Value)
+			{
+				rewritten.m_parameters[i] = Parameter{*constants[i], ParameterMode::Value};
+				++result.m_constantOperands;
+				if (isJump(instruction.m_opCode) && i == 1)
+				{
+					++result.m_resolvedJumps;
+				}
+			}
+		}
+
+		OpCode opCode = instruction.m_opCode;
+		if (opCode == OpCode::Add || opCode == OpCode::Mult || opCode == OpCode::LessThan ||
+		    opCode == OpCode::Equals)
+		{
+			const Parameter&            target = instruction.m_parameters[2];
+			std::optional<ProgramValue> stored;
+			if (target.m_mode == ParameterMode::Position)
+			{
+				stored = target.m_value;
+			}
+			else if (site.m_relativeBase)
+			{
+				stored = target.m_value + *site.m_relativeBase;
+			}
+			std::optional<ProgramValue> folded;
+			if (constants[0] && constants[1])
+			{
+				folded = fold(opCode, *constants[0], *constants[1]);
+			}
+			// Comparisons cannot overflow, so a dead one is always removable.
+			bool canOverflow = opCode == OpCode::Add || opCode == OpCode::Mult;
+			if (stored && analysis.neverRead(*stored) && (folded || !canOverflow))
+			{
+				rewritten.m_opCode        = OpCode::JumpTrue;
+				rewritten.m_numParameters = numParams(OpCode::JumpTrue);
+				rewritten.m_parameters[0] = Parameter{1, ParameterMode::Value};
+				rewritten.m_parameters[1] = Parameter{address + 4, ParameterMode::Value};
+				++result.m_deadStores;
+			}
+			else if (folded && (opCode != OpCode::Add || *constants[1] != 0 ||
+			                    rewritten.m_parameters[0].m_value != *folded))
+			{
+				rewritten.m_opCode        = OpCode::Add;
+				rewritten.m_parameters[0] = Parameter{*folded, ParameterMode::Value};
+				rewritten.m_parameters[1] = Parameter{0, ParameterMode::Value};
+				++result.m_foldedInstructions;
+			}
+		}
+		encode(result.m_program, address, rewritten);
+	}
+	return result;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Intcode.h"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Static analysis of a program image before it runs. Starting at address 0,
+// every instruction reachable through fall-through and resolvable jumps is
+// decoded, together with the memory it may read and write. Words that no
+// reachable store can hit keep their image value for the whole run, so
+// operands read from them are constants; that in turn resolves more jumps,
+// and the exploration is repeated until the set of written words is stable.
+// The relative base is tracked as a range through constant nudges.
+//
+// The results only hold if the exploration saw every instruction that can
+// execute: m_complete is false when a jump target, a store address or a
+// relative base nudge could not be bounded, an unknown opcode is reachable,
+// or a store may hit an instruction word, and then nothing is proven.
+struct ProgramAnalysis
+{
+	enum class Use : uint8_t
+	{
+		Unused,
+		Code,
+		Data,
+		// Executed, and also read as data.
+		CodeAndData
+	};
+
+	struct Site
+	{
+		Instruction                 m_instruction;
+		// Relative base on entry, when it is the same on every visit.
+		std::optional<ProgramValue> m_relativeBase;
+		std::vector<ProgramValue>   m_successors;
+	};
+
+	struct BasicBlock
+	{
+		// One past the last word of the block's final instruction.
+		ProgramValue              m_end{};
+		std::vector<ProgramValue> m_successors;
+		// Ends in a jump whose target could not be resolved.
+		bool                      m_indirect{};
+	};
+
+	bool                               m_complete{};
+	// Reachable instructions by address; may overlap if code jumps into the
+	// middle of another instruction.
+	std::map<ProgramValue, Site>       m_sites;
+	// Control-flow graph, keyed by entry address.
+	std::map<ProgramValue, BasicBlock> m_blocks;
+	// One per word of the image.
+	std::vector<Use>                   m_uses;
+
+	// Only true when the analysis is complete and no reachable store may hit
+	// the address.
+	bool neverWritten(ProgramValue address) const;
+	// Only true when the analysis is complete and no reachable instruction
+	// may read the address as data.
+	bool neverRead(ProgramValue address) const;
+	// The value the parameter of the instruction at address always has, if
+	// it is a constant: an immediate, or a read of a word never written.
+	std::optional<ProgramValue> constantOperand(const Program& program, ProgramValue address,
+	                                            int parameter) const;
+
+	// Inclusive address ranges, sorted and merged.
+	using Ranges = std::vector<std::pair<ProgramValue, ProgramValue>>;
+
+	Ranges m_written;
+	bool   m_writesAnywhere{};
+	Ranges m_read;
+	bool   m_readsAnywhere{};
+};
+
+ProgramAnalysis analyzeProgram(const Program& program);
+
+// An image rewritten using a complete analysis. Each instruction is kept at
+// its address and length, so only instructions whose words are neither
+// read as data nor shared with an overlapping instruction are rewritten:
+// - operands read from never-written words become immediates, which
+//   resolves jump targets held in constant tables;
+// - Add, Mult, LessThan and Equals with constant inputs become an Add of
+//   the result and 0, when the result fits 32 bits so every word type
+//   agrees;
+// - a store whose target is never read becomes a jump to the next
+//   instruction, if it cannot overflow.
+// The rewritten program produces the same outputs for the same inputs, but
+// memory left behind differs, so hosts that inspect memory (BatchRuntime)
+// should keep the original. When the analysis is incomplete the program is
+// returned unchanged.
+struct OptimizedProgram
+{
+	Program m_program;
+	// Pass to Runtime::setImmutableCode().
+	bool    m_immutableCode{};
+	int     m_constantOperands{};
+	int     m_resolvedJumps{};
+	int     m_foldedInstructions{};
+	int     m_deadStores{};
+};
+
+OptimizedProgram optimizeProgram(const Program& program, const ProgramAnalysis& analysis);
@@ -0,0 +1,611 @@
+#include "BatchRuntime.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Lane-wise kernels over rows of n values. The scalar loops are written so
+// the compiler can vectorise them for the baseline instruction set; AVX2 and
+// AVX-512 versions are compiled alongside them and picked at run time, so a
+// portable build still uses the host's vector width.
+namespace
+{
+using LaneKernel = void (*)(const ProgramValue*, const ProgramValue*, ProgramValue*, size_t);
+
+void
+addLanes(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[i] = a[i] + b[i];
+	}
+}
+
+void
+multLanes(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[i] = a[i] * b[i];
+	}
+}
+
+void
+lessThanLanes(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[i] = a[i] < b[i] ? 1 : 0;
+	}
+}
+
+void
+equalsLanes(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[i] = a[i] == b[i] ? 1 : 0;
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void
+addLanesAvx2(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi64(x, y));
+	}
+	addLanes(a + i, b + i, out + i, n - i);
+}
+
+// AVX2 has no 64-bit multiply.
+__attribute__((target("avx512f,avx512dq"))) void
+multLanesAvx512(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m512i x = _mm512_loadu_si512(a + i);
+		__m512i y = _mm512_loadu_si512(b + i);
+		_mm512_storeu_si512(out + i, _mm512_mullo_epi64(x, y));
+	}
+	multLanes(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+lessThanLanesAvx2(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	size_t        i   = 0;
+	const __m256i one = _mm256_set1_epi64x(1);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+		                    _mm256_and_si256(_mm256_cmpgt_epi64(y, x), one));
+	}
+	lessThanLanes(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void
+equalsLanesAvx2(const ProgramValue* a, const ProgramValue* b, ProgramValue* out, size_t n)
+{
+	size_t        i   = 0;
+	const __m256i one = _mm256_set1_epi64x(1);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+		                    _mm256_and_si256(_mm256_cmpeq_epi64(x, y), one));
+	}
+	equalsLanes(a + i, b + i, out + i, n - i);
+}
+#endif
+
+struct LaneKernels
+{
+	LaneKernel m_add{addLanes};
+	LaneKernel m_mult{multLanes};
+	LaneKernel m_lessThan{lessThanLanes};
+	LaneKernel m_equals{equalsLanes};
+};
+
+// The widest kernels the CPU running the program supports, picked once.
+const LaneKernels&
+laneKernels()
+{
+	static const LaneKernels kernels = [] {
+		LaneKernels result;
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			result.m_add      = addLanesAvx2;
+			result.m_lessThan = lessThanLanesAvx2;
+			result.m_equals   = equalsLanesAvx2;
+		}
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+		{
+			result.m_mult = multLanesAvx512;
+		}
+#endif
+		return result;
+	}();
+	return kernels;
+}
+
+bool
+isUniform(const ProgramValue* values, size_t n)
+{
+	return std::all_of(values, values + n,
+	                   [first = values[0]](ProgramValue value) { return value == first; });
+}
+
+// Copies n values from a row, or zeros for a row never written.
+void
+copyRow(const ProgramValue* row, ProgramValue* to, size_t n)
+{
+	if (row)
+	{
+		std::copy_n(row, n, to);
+	}
+	else
+	{
+		std::fill_n(to, n, 0);
+	}
+}
+
+// Copies the given columns of a page of rows width wide into a page of rows
+// as wide as there are columns.
+void
+copyColumns(const std::vector<ProgramValue>& from, size_t width,
+            const std::vector<size_t>& columns, std::vector<ProgramValue>& to)
+{
+	size_t rows = from.size() / width;
+	for (size_t row = 0; row < rows; ++row)
+	{
+		for (size_t i = 0; i < columns.size(); ++i)
+		{
+			to[row * columns.size() + i] = from[row * width + columns[i]];
+		}
+	}
+}
+} // namespace
+
+size_t
+BatchRuntime::Group::width() const
+{
+	return m_lanes.size();
+}
+
+std::vector<ProgramValue>&
+BatchRuntime::Group::page(uint64_t number)
+{
+	std::vector<ProgramValue>* contents;
+	if (number < maxTablePages)
+	{
+		if (number >= m_pages.size())
+		{
+			m_pages.resize(number + 1);
+		}
+		contents = &m_pages[number];
+	}
+	else
+	{
+		contents = &m_sparse[number];
+	}
+	if (contents->empty())
+	{
+		contents->resize(rowsPerPage * width());
+	}
+	return *contents;
+}
+
+ProgramValue*
+BatchRuntime::Group::row(ProgramValue address)
+{
+	uint64_t index = static_cast<uint64_t>(address);
+	return page(index >> rowPageBits).data() + (index & (rowsPerPage - 1)) * width();
+}
+
+const ProgramValue*
+BatchRuntime::Group::findRow(ProgramValue address) const
+{
+	uint64_t                         index    = static_cast<uint64_t>(address);
+	uint64_t                         number   = index >> rowPageBits;
+	const std::vector<ProgramValue>* contents = nullptr;
+	if (number < m_pages.size())
+	{
+		contents = &m_pages[number];
+	}
+	else if (auto it = m_sparse.find(number); it != m_sparse.end())
+	{
+		contents = &it->second;
+	}
+	if (!contents || contents->empty())
+	{
+		return nullptr;
+	}
+	return contents->data() + (index & (rowsPerPage - 1)) * width();
+}
+
+ProgramValue
+BatchRuntime::Group::load(ProgramValue address, size_t column) const
+{
+	const ProgramValue* values = findRow(address);
+	return values ? values[column] : 0;
+}
+
+BatchRuntime::BatchRuntime(const Program& program, size_t lanes)
+    : m_locations(lanes)
+    , m_inputs(lanes)
+    , m_outputs(lanes)
+{
+	Group group;
+	group.m_lanes.resize(lanes);
+	for (size_t lane = 0; lane < lanes; ++lane)
+	{
+		group.m_lanes[lane] = lane;
+		m_locations[lane]   = Location{0, lane};
+	}
+	for (size_t address = 0; address < program.size(); ++address)
+	{
+		std::fill_n(group.row(static_cast<ProgramValue>(address)), lanes, program[address]);
+	}
+	m_groups.push_back(std::move(group));
+}
+
+size_t
+BatchRuntime::lanes() const
+{
+	return m_locations.size();
+}
+
+size_t
+BatchRuntime::groups() const
+{
+	return m_groups.size();
+}
+
+void
+BatchRuntime::write(size_t lane, ProgramValue address, ProgramValue value)
+{
+	Location location = m_locations[lane];
+	m_groups[location.m_group].row(address)[location.m_column] = value;
+}
+
+ProgramValue
+BatchRuntime::read(size_t lane, ProgramValue address) const
+{
+	Location location = m_locations[lane];
+	return m_groups[location.m_group].load(address, location.m_column);
+}
+
+void
+BatchRuntime::addInput(size_t lane, ProgramValue value)
+{
+	m_inputs[lane].push(value);
+}
+
+std::optional<ProgramValue>
+BatchRuntime::getOutput(size_t lane)
+{
+	if (m_outputs[lane].empty())
+	{
+		return {};
+	}
+	return m_outputs[lane].pop();
+}
+
+BatchRuntime::State
+BatchRuntime::state(size_t lane) const
+{
+	return m_groups[m_locations[lane].m_group].m_state;
+}
+
+void
+BatchRuntime::run()
+{
+	// Splitting appends groups, so keep going until every group, including
+	// the new ones, has stopped.
+	for (size_t group = 0; group < m_groups.size(); ++group)
+	{
+		runGroup(group);
+	}
+}
+
+void
+BatchRuntime::runGroup(size_t group)
+{
+	if (m_groups[group].m_state == State::Halted)
+	{
+		return;
+	}
+	m_groups[group].m_state = State::Running;
+	while (step(group))
+	{
+	}
+}
+
+// Fills scratch with width() operand values: the operand row itself for
+// immediates, a memory row when every lane addresses the same cell, or a
+// per-lane gather otherwise. Values are copied out because a later store
+// may overwrite the rows.
+const ProgramValue*
+BatchRuntime::operand(Group& group, ProgramValue address, ParameterMode mode,
+                      std::vector<ProgramValue>& scratch)
+{
+	size_t width = group.width();
+	scratch.resize(width);
+	copyRow(group.findRow(address), scratch.data(), width);
+	if (mode == ParameterMode::Value)
+	{
+		return scratch.data();
+	}
+	ProgramValue base = mode == ParameterMode::RelativePosition ? group.m_relativeBase : 0;
+	if (isUniform(scratch.data(), width))
+	{
+		copyRow(group.findRow(scratch[0] + base), scratch.data(), width);
+		return scratch.data();
+	}
+	for (size_t column = 0; column < width; ++column)
+	{
+		scratch[column] = group.load(scratch[column] + base, column);
+	}
+	return scratch.data();
+}
+
+void
+BatchRuntime::store(Group& group, ProgramValue address, ParameterMode mode,
+                    const ProgramValue* values)
+{
+	ProgramValue base = mode == ParameterMode::RelativePosition ? group.m_relativeBase : 0;
+	const ProgramValue* words = group.row(address);
+	if (isUniform(words, group.width()))
+	{
+		ProgramValue* target = group.row(words[0] + base);
+		std::copy_n(values, group.width(), target);
+		return;
+	}
+	std::vector<ProgramValue> targets(words, words + group.width());
+	for (size_t column = 0; column < group.width(); ++column)
+	{
+		group.row(targets[column] + base)[column] = values[column];
+	}
+}
+
+bool
+BatchRuntime::step(size_t index)
+{
+	Group&       group = m_groups[index];
+	size_t       width = group.width();
+	ProgramValue ip    = group.m_instructionPointer;
+	ProgramValue rb    = group.m_relativeBase;
+	if constexpr (DefaultPolicy::validate)
+	{
+		validate(group);
+	}
+	const ProgramValue* opcodes = group.row(ip);
+	auto& keys = m_splitKeys;
+	keys.resize(width);
+	if (!isUniform(opcodes, width))
+	{
+		for (size_t column = 0; column < width; ++column)
+		{
+			keys[column] = SplitKey{ip, rb, opcodes[column]};
+		}
+		split(index, keys);
+		return true;
+	}
+
+	Instruction instruction{};
+	instruction.m_opCode        = static_cast<OpCode>(opcodes[0] % 100);
+	instruction.m_numParameters = numParams(instruction.m_opCode);
+	ProgramValue modes          = opcodes[0] / 100;
+	for (int i = 0; i < instruction.m_numParameters; ++i)
+	{
+		instruction.m_parameters[i].m_mode  = static_cast<ParameterMode>(modes % 10);
+		instruction.m_parameters[i].m_value = ip + 1 + i;
+		modes /= 10;
+	}
+	const auto&  p    = instruction.m_parameters;
+	ProgramValue next = ip + 1 + instruction.m_numParameters;
+	auto         in   = [&](int i) {
+		return operand(group, p[i].m_value, p[i].m_mode, m_scratch[i]);
+	};
+	auto& out = m_scratch[maxParams];
+	out.resize(width);
+
+	switch (instruction.m_opCode)
+	{
+	case OpCode::Add:
+		laneKernels().m_add(in(0), in(1), out.data(), width);
+		store(group, p[2].m_value, p[2].m_mode, out.data());
+		break;
+	case OpCode::Mult:
+		laneKernels().m_mult(in(0), in(1), out.data(), width);
+		store(group, p[2].m_value, p[2].m_mode, out.data());
+		break;
+	case OpCode::LessThan:
+		laneKernels().m_lessThan(in(0), in(1), out.data(), width);
+		store(group, p[2].m_value, p[2].m_mode, out.data());
+		break;
+	case OpCode::Equals:
+		laneKernels().m_equals(in(0), in(1), out.data(), width);
+		store(group, p[2].m_value, p[2].m_mode, out.data());
+		break;
+	case OpCode::Input:
+	{
+		for (size_t column = 0; column < width; ++column)
+		{
+			keys[column] = SplitKey{ip, rb, !m_inputs[group.m_lanes[column]].empty()};
+		}
+		if (!std::all_of(keys.begin(), keys.end(),
+		                 [&](const SplitKey& key) { return key == keys[0]; }))
+		{
+			split(index, keys);
+			return true;
+		}
+		if (!std::get<2>(keys[0]))
+		{
+			group.m_state = State::AwaitingInput;
+			return false;
+		}
+		for (size_t column = 0; column < width; ++column)
+		{
+			out[column] = m_inputs[group.m_lanes[column]].pop();
+		}
+		store(group, p[0].m_value, p[0].m_mode, out.data());
+		break;
+	}
+	case OpCode::Output:
+	{
+		const ProgramValue* values = in(0);
+		for (size_t column = 0; column < width; ++column)
+		{
+			m_outputs[group.m_lanes[column]].push(values[column]);
+		}
+		break;
+	}
+	case OpCode::JumpTrue:
+	case OpCode::JumpFalse:
+	{
+		const ProgramValue* condition = in(0);
+		const ProgramValue* target    = in(1);
+		bool                jumpIf    = instruction.m_opCode == OpCode::JumpTrue;
+		for (size_t column = 0; column < width; ++column)
+		{
+			out[column] = ((condition[column] != 0) == jumpIf) ? target[column] : next;
+		}
+		if (!isUniform(out.data(), width))
+		{
+			for (size_t column = 0; column < width; ++column)
+			{
+				keys[column] = SplitKey{out[column], rb, 0};
+			}
+			split(index, keys);
+			return true;
+		}
+		next = out[0];
+		break;
+	}
+	case OpCode::NudgeRelativeBase:
+	{
+		const ProgramValue* offset = in(0);
+		if (!isUniform(offset, width))
+		{
+			for (size_t column = 0; column < width; ++column)
+			{
+				keys[column] = SplitKey{next, rb + offset[column], 0};
+			}
+			split(index, keys);
+			return true;
+		}
+		group.m_relativeBase += offset[0];
+		break;
+	}
+	case OpCode::Halt:
+		group.m_state = State::Halted;
+		return false;
+	default:
+		// Unknown opcodes are skipped, as in Runtime.
+		break;
+	}
+	group.m_instructionPointer = next;
+	return true;
+}
+
+// Traps with the error a validating Runtime raises if the next instruction
+// is invalid in any lane, decoding it from each lane's own memory.
+void
+BatchRuntime::validate(const Group& group) const
+{
+	struct LaneMemory
+	{
+		const Group& m_group;
+		size_t       m_column;
+
+		ProgramValue
+		operator[](ProgramValue address) const
+		{
+			return m_group.load(address, m_column);
+		}
+	};
+
+	ProgramValue ip = group.m_instructionPointer;
+	for (size_t column = 0; column < group.width(); ++column)
+	{
+		validateInstruction(decodeInstruction(LaneMemory{group, column}, ip), ip,
+		                    group.m_relativeBase, DefaultPolicy::maxAddress);
+	}
+}
+
+// Splits a group into one sub-group per distinct key. The key carries the
+// instruction pointer and relative base each lane continues with, plus a tag
+// separating lanes that stay on the same instruction but disagree on it (a
+// different opcode word, or only some lanes having input).
+void
+BatchRuntime::split(size_t index, const std::vector<SplitKey>& keys)
+{
+	Group  source = std::move(m_groups[index]);
+	size_t width  = source.width();
+	std::map<SplitKey, std::vector<size_t>> columns;
+	for (size_t column = 0; column < width; ++column)
+	{
+		columns[keys[column]].push_back(column);
+	}
+
+	size_t target = index;
+	for (const auto& [key, members] : columns)
+	{
+		Group group;
+		group.m_instructionPointer = std::get<0>(key);
+		group.m_relativeBase       = std::get<1>(key);
+		group.m_state              = source.m_state;
+		for (size_t member : members)
+		{
+			group.m_lanes.push_back(source.m_lanes[member]);
+		}
+		for (uint64_t number = 0; number < source.m_pages.size(); ++number)
+		{
+			if (!source.m_pages[number].empty())
+			{
+				copyColumns(source.m_pages[number], width, members, group.page(number));
+			}
+		}
+		for (const auto& [number, contents] : source.m_sparse)
+		{
+			copyColumns(contents, width, members, group.page(number));
+		}
+		if (target == index)
+		{
+			m_groups[index] = std::move(group);
+		}
+		else
+		{
+			m_groups.push_back(std::move(group));
+		}
+		relocate(target);
+		target = m_groups.size();
+	}
+}
+
+void
+BatchRuntime::relocate(size_t index)
+{
+	const Group& group = m_groups[index];
+	for (size_t column = 0; column < group.width(); ++column)
+	{
+		m_locations[group.m_lanes[column]] = Location{index, column};
+	}
+}
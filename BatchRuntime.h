@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Intcode.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Runs many instances ("lanes") of one program in lockstep. Lanes that share
+// an instruction pointer and relative base form a group whose memory is laid
+// out structure-of-arrays, one row of lane values per address, so Add, Mult,
+// LessThan and Equals become vector operations over whole rows. Operands
+// whose address differs between lanes are gathered and scattered per lane.
+// When lanes diverge (different jump outcome, relative base or opcode word)
+// the group splits into sub-groups that continue independently.
+class BatchRuntime
+{
+public:
+	using State = Runtime::State;
+
+	BatchRuntime(const Program& program, size_t lanes);
+
+	size_t                      lanes() const;
+	void                        write(size_t lane, ProgramValue address, ProgramValue value);
+	ProgramValue                read(size_t lane, ProgramValue address) const;
+	void                        addInput(size_t lane, ProgramValue value);
+	std::optional<ProgramValue> getOutput(size_t lane);
+	State                       state(size_t lane) const;
+	size_t                      groups() const;
+
+	// Runs every group until it halts or a lane in it needs input it lacks.
+	void run();
+
+private:
+	// Rows are kept in pages allocated on first write, as in PagedMemory:
+	// a flat table for low addresses and a hash map above it, so the whole
+	// 64-bit address space is usable, negative addresses included, and a
+	// far-flung store costs one page rather than every row below it.
+	static constexpr int      rowPageBits   = 6;
+	static constexpr uint64_t rowsPerPage   = uint64_t{1} << rowPageBits;
+	static constexpr uint64_t maxTablePages = uint64_t{1} << 14;
+
+	struct Group
+	{
+		std::vector<size_t>                                     m_lanes;
+		std::vector<std::vector<ProgramValue>>                  m_pages;
+		std::unordered_map<uint64_t, std::vector<ProgramValue>> m_sparse;
+		ProgramValue                                            m_instructionPointer{};
+		ProgramValue                                            m_relativeBase{};
+		State                                                   m_state{State::Initialized};
+
+		size_t                     width() const;
+		// Allocates the row's page if need be. Rows stay put as others are
+		// allocated.
+		ProgramValue*              row(ProgramValue address);
+		// Null if the row's page was never written, so every lane reads 0.
+		const ProgramValue*        findRow(ProgramValue address) const;
+		ProgramValue               load(ProgramValue address, size_t column) const;
+		std::vector<ProgramValue>& page(uint64_t number);
+	};
+
+	struct Location
+	{
+		size_t m_group{};
+		size_t m_column{};
+	};
+
+	// Instruction pointer, relative base and a tie-breaking tag.
+	using SplitKey = std::tuple<ProgramValue, ProgramValue, ProgramValue>;
+
+	void                runGroup(size_t group);
+	bool                step(size_t group);
+	void                validate(const Group& group) const;
+	const ProgramValue* operand(Group& group, ProgramValue address,
+	                            ParameterMode mode, std::vector<ProgramValue>& scratch);
+	void                store(Group& group, ProgramValue address, ParameterMode mode,
+	                          const ProgramValue* values);
+	void                split(size_t group, const std::vector<SplitKey>& keys);
+	void                relocate(size_t group);
+
+	std::vector<Group>                    m_groups;
+	std::vector<Location>                 m_locations;
+	std::vector<RingBuffer<ProgramValue>> m_inputs;
+	std::vector<RingBuffer<ProgramValue>> m_outputs;
+	std::vector<ProgramValue>             m_scratch[maxParams + 1];
+	std::vector<SplitKey>                 m_splitKeys;
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Lock-free unbounded queues carrying values between threads in batches,
+// each with a single consumer. SpscQueue takes push() from one producer
+// thread and appends into fixed-size segments; MpscQueue takes push() from
+// any number of threads, one node per batch, so a batch is never
+// interleaved with another producer's values.
+//
+// empty() may miss a batch whose push() has not returned yet, so a
+// producer that parks its consumer has to signal it after push() returns.
+//
+// BoundedSpscQueue is a fixed ring instead, for producers that should be
+// held back by a slow consumer.
+
+template <typename T>
+class SpscQueue
+{
+public:
+	static constexpr size_t segmentSize = 1024;
+
+	SpscQueue()
+	    : m_head(new Segment)
+	    , m_tail(m_head)
+	{
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	~SpscQueue()
+	{
+		while (m_head)
+		{
+			delete std::exchange(m_head, m_head->m_next.load(std::memory_order_relaxed));
+		}
+	}
+
+	// Producer only.
+	void
+	push(std::span<const T> values)
+	{
+		while (!values.empty())
+		{
+			size_t written = m_tail->m_written.load(std::memory_order_relaxed);
+			if (written == segmentSize)
+			{
+				Segment* next = new Segment;
+				m_tail->m_next.store(next, std::memory_order_release);
+				m_tail = next;
+				continue;
+			}
+			size_t count = std::min(values.size(), segmentSize - written);
+			std::copy_n(values.begin(), count, m_tail->m_values.begin() + written);
+			m_tail->m_written.store(written + count, std::memory_order_release);
+			values = values.subspan(count);
+		}
+	}
+
+	// Calls visit with spans of every value pushed so far, oldest first.
+	// Consumer only.
+	template <typename Visit>
+	void
+	consume(Visit visit)
+	{
+		for (;;)
+		{
+			size_t written = m_head->m_written.load(std::memory_order_acquire);
+			if (m_read < written)
+			{
+				visit(std::span<const T>(m_head->m_values.data() + m_read, written - m_read));
+				m_read = written;
+			}
+			Segment* next = m_head->m_next.load(std::memory_order_acquire);
+			if (m_read < segmentSize || !next)
+			{
+				return;
+			}
+			delete std::exchange(m_head, next);
+			m_read = 0;
+		}
+	}
+
+	// Consumer only.
+	bool
+	empty() const
+	{
+		if (m_read < m_head->m_written.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		Segment* next = m_read == segmentSize ? m_head->m_next.load(std::memory_order_acquire)
+		                                      : nullptr;
+		return !next || next->m_written.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+	struct Segment
+	{
+		std::array<T, segmentSize> m_values;
+		std::atomic<size_t>        m_written{0};
+		std::atomic<Segment*>      m_next{nullptr};
+	};
+
+	// The consumer's and the producer's ends on separate cache lines.
+	alignas(64) Segment* m_head;
+	size_t               m_read{};
+	alignas(64) Segment* m_tail;
+};
+
+// Intrusive queue after Vyukov: push() swings the tail to the new node with
+// one exchange and then links the old tail to it. The head is a spent stub
+// node whose successor holds the oldest batch.
+template <typename T>
+class MpscQueue
+{
+public:
+	MpscQueue()
+	    : m_head(new Node)
+	    , m_tail(m_head)
+	{
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue()
+	{
+		while (m_head)
+		{
+			delete std::exchange(m_head, m_head->m_next.load(std::memory_order_relaxed));
+		}
+	}
+
+	void
+	push(std::span<const T> values)
+	{
+		if (values.empty())
+		{
+			return;
+		}
+		Node* node = new Node;
+		node->m_values.assign(values.begin(), values.end());
+		Node* previous = m_tail.exchange(node, std::memory_order_acq_rel);
+		previous->m_next.store(node, std::memory_order_release);
+	}
+
+	// Calls visit with each batch pushed so far, oldest first. Consumer
+	// only.
+	template <typename Visit>
+	void
+	consume(Visit visit)
+	{
+		while (Node* next = m_head->m_next.load(std::memory_order_acquire))
+		{
+			delete std::exchange(m_head, next);
+			visit(std::span<const T>(next->m_values));
+			std::vector<T>().swap(next->m_values);
+		}
+	}
+
+	// Consumer only.
+	bool
+	empty() const
+	{
+		return !m_head->m_next.load(std::memory_order_acquire);
+	}
+
+private:
+	struct Node
+	{
+		std::atomic<Node*> m_next{nullptr};
+		std::vector<T>     m_values;
+	};
+
+	alignas(64) Node*              m_head;
+	alignas(64) std::atomic<Node*> m_tail;
+};
+
+// Single-producer, single-consumer ring of fixed capacity. Neither side
+// blocks: push() takes what fits and pop() what is there, so a thread can
+// wait for room and for input at the same time.
+template <typename T>
+class BoundedSpscQueue
+{
+public:
+	explicit BoundedSpscQueue(size_t capacity)
+	    : m_values(std::bit_ceil(std::max<size_t>(capacity, 1)))
+	    , m_mask(m_values.size() - 1)
+	{
+	}
+
+	BoundedSpscQueue(const BoundedSpscQueue&) = delete;
+	BoundedSpscQueue& operator=(const BoundedSpscQueue&) = delete;
+
+	// Returns how many values fitted. Producer only.
+	size_t
+	push(std::span<const T> values)
+	{
+		size_t tail  = m_tail.load(std::memory_order_relaxed);
+		size_t count = std::min(values.size(), room());
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_values[(tail + i) & m_mask] = values[i];
+		}
+		m_tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	// Producer only.
+	size_t
+	room() const
+	{
+		return m_values.size() - (m_tail.load(std::memory_order_relaxed) -
+		                          m_head.load(std::memory_order_acquire));
+	}
+
+	// Moves up to values.size() values into values and returns how many.
+	// Consumer only.
+	size_t
+	pop(std::span<T> values)
+	{
+		size_t head  = m_head.load(std::memory_order_relaxed);
+		size_t count = std::min(values.size(), m_tail.load(std::memory_order_acquire) - head);
+		for (size_t i = 0; i < count; ++i)
+		{
+			values[i] = m_values[(head + i) & m_mask];
+		}
+		m_head.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+private:
+	std::vector<T>                  m_values;
+	size_t                          m_mask;
+	alignas(64) std::atomic<size_t> m_head{};
+	alignas(64) std::atomic<size_t> m_tail{};
+};
@@ -0,0 +1,207 @@
+#include "Checkpoint.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// File layout, integers and words in host byte order: a 64-byte header of
+// "ICCP", version, word size, two zero bytes and a byte order mark, padded
+// with zeros; then records. A record is a 64-bit length, state, flags,
+// input count, output count and page count; the page numbers; padding to
+// the next 64-byte boundary; the page contents; the registers and queues;
+// padding; and the length again as its last eight bytes. Records are a
+// multiple of 64 bytes long, so every page stays aligned in the file.
+namespace
+{
+constexpr char     magic[4]  = {'I', 'C', 'C', 'P'};
+constexpr uint8_t  version   = 1;
+constexpr uint64_t byteOrder = 0x0102030405060708;
+constexpr size_t   alignment = 64;
+constexpr size_t   fields    = 6;
+
+size_t
+aligned(size_t size)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+void
+appendUint64(std::vector<char>& bytes, uint64_t value)
+{
+	const char* data = reinterpret_cast<const char*>(&value);
+	bytes.insert(bytes.end(), data, data + sizeof(value));
+}
+
+uint64_t
+readUint64(const std::byte* data)
+{
+	uint64_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+// Flushes a file, or with O_DIRECTORY in flags a directory's entries, to
+// disk.
+void
+syncToDisk(const std::string& path, int flags)
+{
+	int descriptor = ::open(path.c_str(), flags);
+	if (descriptor < 0 || ::fsync(descriptor) != 0)
+	{
+		int error = errno;
+		if (descriptor >= 0)
+		{
+			::close(descriptor);
+		}
+		throw std::runtime_error(path + ": " + std::strerror(error));
+	}
+	::close(descriptor);
+}
+
+std::runtime_error
+malformed(const std::string& fileName, const std::string& what)
+{
+	return std::runtime_error(fileName + ": checkpoint: " + what);
+}
+} // namespace
+
+void
+writeCheckpoint(const std::string& fileName, size_t wordSize, size_t pageBytes,
+                const CheckpointRecord& record, bool full)
+{
+	if (pageBytes % alignment != 0)
+	{
+		throw std::logic_error("checkpoint: pages must be a multiple of 64 bytes");
+	}
+	size_t pagesOffset = aligned((fields + record.m_pages.size()) * sizeof(uint64_t));
+	size_t wordsOffset = pagesOffset + record.m_pages.size() * pageBytes;
+	size_t length      = aligned(wordsOffset + record.m_words.size() + sizeof(uint64_t));
+
+	std::vector<char> prefix;
+	appendUint64(prefix, length);
+	appendUint64(prefix, record.m_state);
+	appendUint64(prefix, record.m_flags);
+	appendUint64(prefix, record.m_inputs);
+	appendUint64(prefix, record.m_outputs);
+	appendUint64(prefix, record.m_pages.size());
+	for (const auto& [page, contents] : record.m_pages)
+	{
+		appendUint64(prefix, page);
+	}
+	prefix.resize(pagesOffset);
+
+	std::vector<char> suffix(length - wordsOffset);
+	std::memcpy(suffix.data(), record.m_words.data(), record.m_words.size());
+	std::memcpy(suffix.data() + suffix.size() - sizeof(uint64_t), &length, sizeof(uint64_t));
+
+	std::string   path = full ? fileName + ".tmp" : fileName;
+	std::ofstream file(path, std::ios::binary | (full ? std::ios::trunc : std::ios::app));
+	if (!file)
+	{
+		throw std::runtime_error(path + ": cannot open for writing");
+	}
+	if (full)
+	{
+		char header[alignment]{};
+		std::memcpy(header, magic, sizeof(magic));
+		header[4] = static_cast<char>(version);
+		header[5] = static_cast<char>(wordSize);
+		std::memcpy(header + 8, &byteOrder, sizeof(byteOrder));
+		file.write(header, sizeof(header));
+	}
+	file.write(prefix.data(), prefix.size());
+	for (const auto& [page, contents] : record.m_pages)
+	{
+		file.write(reinterpret_cast<const char*>(contents), pageBytes);
+	}
+	file.write(suffix.data(), suffix.size());
+	file.close();
+	if (!file)
+	{
+		throw std::runtime_error(path + ": write failed");
+	}
+	if (full)
+	{
+		// The new contents reach the disk before the name does, and the
+		// rename is on disk before this returns.
+		syncToDisk(path, O_RDONLY);
+		if (std::rename(path.c_str(), fileName.c_str()) != 0)
+		{
+			throw std::runtime_error(fileName + ": " + std::strerror(errno));
+		}
+		std::string directory = std::filesystem::path(fileName).parent_path().string();
+		syncToDisk(directory.empty() ? "." : directory, O_RDONLY | O_DIRECTORY);
+	}
+}
+
+CheckpointImage::CheckpointImage(const std::string& fileName, size_t wordSize, size_t pageBytes)
+    : m_file(fileName, true)
+{
+	const std::byte* data = static_cast<const std::byte*>(m_file.data());
+	size_t           size = m_file.size();
+	if (size < alignment || std::memcmp(data, magic, sizeof(magic)) != 0)
+	{
+		throw malformed(fileName, "bad magic");
+	}
+	if (static_cast<uint8_t>(data[4]) != version)
+	{
+		throw malformed(fileName, "unsupported version");
+	}
+	if (static_cast<size_t>(data[5]) != wordSize || readUint64(data + 8) != byteOrder)
+	{
+		throw malformed(fileName, "written for another word size or byte order");
+	}
+
+	bool                                 complete = false;
+	std::map<uint64_t, const std::byte*> pages;
+	size_t                               offset   = alignment;
+	while (size - offset >= fields * sizeof(uint64_t))
+	{
+		const std::byte* record = data + offset;
+		uint64_t         length = readUint64(record);
+		if (length % alignment != 0 || length == 0 || length > size - offset ||
+		    readUint64(record + length - sizeof(uint64_t)) != length)
+		{
+			// Cut short while it was being appended.
+			break;
+		}
+		uint64_t numPages = readUint64(record + 5 * sizeof(uint64_t));
+		if (numPages > length / pageBytes)
+		{
+			throw malformed(fileName, "bad page count");
+		}
+		size_t pagesOffset = aligned((fields + numPages) * sizeof(uint64_t));
+		size_t wordsOffset = pagesOffset + numPages * pageBytes;
+		m_latest.m_state   = readUint64(record + 1 * sizeof(uint64_t));
+		m_latest.m_flags   = readUint64(record + 2 * sizeof(uint64_t));
+		m_latest.m_inputs  = readUint64(record + 3 * sizeof(uint64_t));
+		m_latest.m_outputs = readUint64(record + 4 * sizeof(uint64_t));
+		uint64_t numWords  = 2 + m_latest.m_inputs + m_latest.m_outputs;
+		if (m_latest.m_inputs > length || m_latest.m_outputs > length ||
+		    wordsOffset + numWords * wordSize + sizeof(uint64_t) > length)
+		{
+			throw malformed(fileName, "bad record");
+		}
+		for (uint64_t i = 0; i < numPages; ++i)
+		{
+			uint64_t page = readUint64(record + (fields + i) * sizeof(uint64_t));
+			pages[page]   = record + pagesOffset + i * pageBytes;
+		}
+		m_latest.m_words.assign(record + wordsOffset, record + wordsOffset + numWords * wordSize);
+		complete = true;
+		offset += length;
+	}
+	if (!complete)
+	{
+		throw malformed(fileName, "no complete record");
+	}
+	m_torn = offset != size;
+	m_latest.m_pages.assign(pages.begin(), pages.end());
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// On-disk checkpoints of a machine, written by BasicRuntime::checkpoint()
+// and resumed by BasicRuntime::restore(). Words are only handled as bytes
+// here, so one implementation serves every word type.
+//
+// A file is a header and a sequence of records. The first record holds
+// every page that has been written; each later one holds the pages written
+// since the record before it, and every record holds the full registers
+// and queues. Page contents are aligned in the file, so a restored machine
+// uses the latest copy of each page straight from the mapping.
+struct CheckpointRecord
+{
+	uint64_t                                           m_state{};
+	uint64_t                                           m_flags{};
+	uint64_t                                           m_inputs{};
+	uint64_t                                           m_outputs{};
+	// Instruction pointer, relative base, inputs and outputs, as raw words
+	// in host byte order.
+	std::vector<std::byte>                             m_words;
+	// Page number and contents.
+	std::vector<std::pair<uint64_t, const std::byte*>> m_pages;
+};
+
+constexpr uint64_t checkpointImmutableCode = 1;
+
+// With full, writes a header and the record to a temporary file and renames
+// it over fileName, so a crash leaves either the old or the new file whole
+// and mappings of the old one stay valid; the file and the rename are on
+// disk before this returns. Otherwise appends the record to a file this
+// wrote before. Throws std::runtime_error if it cannot write.
+void writeCheckpoint(const std::string& fileName, size_t wordSize, size_t pageBytes,
+                     const CheckpointRecord& record, bool full);
+
+// A checkpoint file mapped copy-on-write. A record cut short by a crash is
+// ignored, so the file resumes from the record before it. Throws
+// std::runtime_error if the file is malformed, was written for another word
+// size or holds no complete record.
+class CheckpointImage
+{
+public:
+	CheckpointImage(const std::string& fileName, size_t wordSize, size_t pageBytes);
+
+	// The last complete record, with the latest contents of every page in
+	// the file. Pages point into the mapping, which is writable, and live
+	// as long as this image.
+	const CheckpointRecord&
+	latest() const
+	{
+		return m_latest;
+	}
+
+	// Whether the file holds anything after the last complete record, such
+	// as a record cut short. Records appended after it would never be read,
+	// so the next checkpoint to the file must rewrite it in full.
+	bool
+	torn() const
+	{
+		return m_torn;
+	}
+
+private:
+	MappedFile       m_file;
+	CheckpointRecord m_latest;
+	bool             m_torn{};
+};
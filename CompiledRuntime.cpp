@@ -0,0 +1,69 @@
+#include "CompiledRuntime.h"
+
+CompiledRuntime::State
+CompiledRuntime::state() const
+{
+	if (m_interpreter)
+	{
+		return m_interpreter->state();
+	}
+	return m_state;
+}
+
+bool
+CompiledRuntime::isHalted() const
+{
+	if (m_interpreter)
+	{
+		return m_interpreter->isHalted();
+	}
+	return m_state == State::Halted;
+}
+
+void
+CompiledRuntime::addInput(ProgramValue value)
+{
+	if (m_interpreter)
+	{
+		m_interpreter->addInput(value);
+		return;
+	}
+	m_inputQueue.push(value);
+}
+
+std::optional<ProgramValue>
+CompiledRuntime::getOutput()
+{
+	if (!m_outputQueue.empty())
+	{
+		return m_outputQueue.pop();
+	}
+	if (m_interpreter)
+	{
+		return m_interpreter->getOutput();
+	}
+	return {};
+}
+
+size_t
+CompiledRuntime::drainOutputs(std::span<ProgramValue> outputs)
+{
+	size_t count = m_outputQueue.pop(outputs.data(), outputs.size());
+	if (m_interpreter)
+	{
+		count += m_interpreter->drainOutputs(outputs.subspan(count));
+	}
+	return count;
+}
+
+void
+CompiledRuntime::fallBack(ProgramValue instructionPointer)
+{
+	m_interpreter.emplace(std::move(m_memory), Runtime::Engine::Threaded);
+	m_interpreter->setRegisters(instructionPointer, m_relativeBase);
+	while (!m_inputQueue.empty())
+	{
+		m_interpreter->addInput(m_inputQueue.pop());
+	}
+	m_interpreter->run();
+}
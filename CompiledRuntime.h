@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Intcode.h"
+
+#include <optional>
+#include <vector>
+
+// Host interface for a program translated ahead of time by IntcodeCompiler.
+// It mirrors Runtime's addInput/run/getOutput so hosts can swap one for the
+// other; the generated translation unit supplies the constructor and run().
+// If the program writes into its own code, the machine state is handed to an
+// interpreting Runtime and every later call is forwarded to it.
+class CompiledRuntime
+{
+public:
+	using State = Runtime::State;
+	using Value = ProgramValue;
+
+	CompiledRuntime();
+	void                        run();
+	State                       state() const;
+	bool                        isHalted() const;
+	void                        addInput(ProgramValue);
+	std::optional<ProgramValue> getOutput();
+	size_t                      drainOutputs(std::span<ProgramValue> outputs);
+
+	template <typename Range>
+	void
+	addInputs(const Range& inputs)
+	{
+		for (auto value : inputs)
+		{
+			addInput(value);
+		}
+	}
+
+private:
+	bool store(ProgramValue index, ProgramValue value);
+	void fallBack(ProgramValue instructionPointer);
+
+	Memory                    m_memory;
+	ProgramValue              m_instructionPointer{};
+	ProgramValue              m_relativeBase{};
+	State                     m_state{State::Initialized};
+	RingBuffer<ProgramValue>  m_inputQueue;
+	RingBuffer<ProgramValue>  m_outputQueue;
+	std::optional<Runtime>    m_interpreter;
+};
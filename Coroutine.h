@@ -0,0 +1,324 @@
+#pragma once
+
+#include "Intcode.h"
+
+#include <cassert>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Coroutine-based host API for Runtime. outputs() is a lazy view of what a
+// machine prints, and HostScheduler lets one thread drive many machines
+// from coroutines that suspend while a machine waits for input, instead of
+// polling getOutput() and calling run() speculatively.
+
+template <typename T>
+class Generator
+{
+public:
+	struct promise_type
+	{
+		const T* m_value{};
+
+		Generator
+		get_return_object()
+		{
+			return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always
+		initial_suspend() noexcept
+		{
+			return {};
+		}
+		std::suspend_always
+		final_suspend() noexcept
+		{
+			return {};
+		}
+		std::suspend_always
+		yield_value(const T& value) noexcept
+		{
+			m_value = &value;
+			return {};
+		}
+		void
+		return_void() noexcept
+		{
+		}
+		void
+		unhandled_exception()
+		{
+			std::terminate();
+		}
+	};
+
+	class iterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = T;
+		using difference_type   = std::ptrdiff_t;
+
+		iterator() = default;
+		explicit iterator(std::coroutine_handle<promise_type> handle)
+		    : m_handle(handle)
+		{
+		}
+		const T&
+		operator*() const
+		{
+			return *m_handle.promise().m_value;
+		}
+		iterator&
+		operator++()
+		{
+			m_handle.resume();
+			return *this;
+		}
+		void
+		operator++(int)
+		{
+			++*this;
+		}
+		bool
+		operator==(std::default_sentinel_t) const
+		{
+			return !m_handle || m_handle.done();
+		}
+
+	private:
+		std::coroutine_handle<promise_type> m_handle;
+	};
+
+	explicit Generator(std::coroutine_handle<promise_type> handle)
+	    : m_handle(handle)
+	{
+	}
+	Generator(Generator&& other) noexcept
+	    : m_handle(std::exchange(other.m_handle, {}))
+	{
+	}
+	Generator(const Generator&) = delete;
+	Generator& operator=(const Generator&) = delete;
+	~Generator()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+
+	iterator
+	begin()
+	{
+		m_handle.resume();
+		return iterator(m_handle);
+	}
+	std::default_sentinel_t
+	end()
+	{
+		return {};
+	}
+
+private:
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+// True when running the machine again cannot make progress.
+inline bool
+isBlocked(const Runtime& machine)
+{
+	return machine.isHalted() ||
+	       (machine.state() == Runtime::State::AwaitingInput &&
+	        machine.pendingInputs() == 0);
+}
+
+// Yields every value the machine outputs, running it only when its output
+// queue is empty. Ends when the machine halts or needs input it lacks; add
+// input and iterate a new view to continue.
+inline Generator<ProgramValue>
+outputs(Runtime& machine)
+{
+	for (;;)
+	{
+		while (auto value = machine.getOutput())
+		{
+			co_yield *value;
+		}
+		if (isBlocked(machine))
+		{
+			co_return;
+		}
+		machine.run();
+	}
+}
+
+// Single-threaded cooperative scheduler for host coroutines. A coroutine
+// awaiting output() from a machine that is blocked on input is parked and
+// only resumed (and the machine only run) once send() delivers input that
+// lets the machine produce a value or halt.
+class HostScheduler
+{
+public:
+	class Task
+	{
+	public:
+		struct promise_type
+		{
+			Task
+			get_return_object()
+			{
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always
+			initial_suspend() noexcept
+			{
+				return {};
+			}
+			std::suspend_always
+			final_suspend() noexcept
+			{
+				return {};
+			}
+			void
+			return_void() noexcept
+			{
+			}
+			void
+			unhandled_exception()
+			{
+				std::terminate();
+			}
+		};
+
+		explicit Task(std::coroutine_handle<promise_type> handle)
+		    : m_handle(handle)
+		{
+		}
+
+	private:
+		friend class HostScheduler;
+		std::coroutine_handle<promise_type> m_handle;
+	};
+
+	class OutputAwaiter
+	{
+	public:
+		OutputAwaiter(HostScheduler& scheduler, Runtime& machine)
+		    : m_scheduler(scheduler)
+		    , m_machine(machine)
+		{
+		}
+		bool
+		await_ready()
+		{
+			return m_scheduler.poll(m_machine, m_value);
+		}
+		void
+		await_suspend(std::coroutine_handle<> handle)
+		{
+			assert(!m_scheduler.m_waiters.count(&m_machine));
+			m_scheduler.m_waiters[&m_machine] = handle;
+		}
+		// The machine's next output, or nothing once it has halted.
+		std::optional<ProgramValue>
+		await_resume()
+		{
+			if (!m_value)
+			{
+				m_scheduler.poll(m_machine, m_value);
+			}
+			return m_value;
+		}
+
+	private:
+		HostScheduler&              m_scheduler;
+		Runtime&                    m_machine;
+		std::optional<ProgramValue> m_value;
+	};
+
+	HostScheduler() = default;
+	HostScheduler(const HostScheduler&) = delete;
+	HostScheduler& operator=(const HostScheduler&) = delete;
+	~HostScheduler()
+	{
+		for (auto handle : m_tasks)
+		{
+			handle.destroy();
+		}
+	}
+
+	void
+	spawn(Task task)
+	{
+		m_tasks.push_back(task.m_handle);
+		m_ready.push_back(task.m_handle);
+	}
+
+	// Resumes ready coroutines until every one has finished or is parked.
+	// Returns true if all spawned coroutines finished, false on deadlock.
+	bool
+	run()
+	{
+		while (!m_ready.empty())
+		{
+			auto handle = m_ready.front();
+			m_ready.pop_front();
+			handle.resume();
+		}
+		for (auto handle : m_tasks)
+		{
+			if (!handle.done())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	OutputAwaiter
+	output(Runtime& machine)
+	{
+		return OutputAwaiter(*this, machine);
+	}
+
+	void
+	send(Runtime& machine, ProgramValue value)
+	{
+		machine.addInput(value);
+		auto waiter = m_waiters.find(&machine);
+		if (waiter == m_waiters.end())
+		{
+			return;
+		}
+		machine.run();
+		if (machine.pendingOutputs() > 0 || machine.isHalted())
+		{
+			m_ready.push_back(waiter->second);
+			m_waiters.erase(waiter);
+		}
+	}
+
+private:
+	// Takes the next output if there is one, running the machine only when it
+	// can make progress. Returns false if the caller has to wait for input.
+	bool
+	poll(Runtime& machine, std::optional<ProgramValue>& value)
+	{
+		if (machine.pendingOutputs() == 0 && !isBlocked(machine))
+		{
+			machine.run();
+		}
+		value = machine.getOutput();
+		return value || machine.isHalted();
+	}
+
+	std::vector<std::coroutine_handle<Task::promise_type>>     m_tasks;
+	std::deque<std::coroutine_handle<>>                        m_ready;
+	std::unordered_map<const Runtime*, std::coroutine_handle<>> m_waiters;
+};
@@ -1,349 +1,263 @@
-﻿#include <algorithm>
-#include <array>
-#include <charconv>
-#include <fstream>
-#include <iterator>
-#include <numeric>
-#include <sstream>
-#include <string>
+﻿#include "Coroutine.h"
+#include "Intcode.h"
+#include "Network.h"
+#include "Pipeline.h"
+#include "Sweep.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <utility>
 #include <vector>
 #include <iostream>
-#include <cassert>
-#include <queue>
 
-using Program = std::vector<int>;
+using Phases     = std::vector<int>;
+using Amplifiers = std::vector<Runtime32>;
 
-enum class OpCode : uint8_t
+// How a feedback loop runs: its amplifiers taking turns on this thread,
+// driven by coroutines on this thread, each on its own thread in a
+// pipeline, or as machines of a Network.
+enum class Mode
 {
-	Add    = 1,
-	Mult   = 2,
-	Input  = 3,
-	Output = 4,
-	JumpTrue = 5,
-	JumpFalse = 6,
-	LessThan = 7,
-	Equals = 8,
-	Halt   = 99
+	Turns,
+	Coroutines,
+	Pipelined,
+	Network
 };
 
-std::ostream&
-operator<<(std::ostream& ostream, const OpCode& opCode)
+// Passes each output of one amplifier on to the next until it halts,
+// noting the last one if asked.
+HostScheduler::Task
+relay(HostScheduler& scheduler, Runtime& from, Runtime& to, ProgramValue* last)
 {
-	switch (opCode)
+	while (auto value = co_await scheduler.output(from))
 	{
-	case OpCode::Add:
-		ostream << "Add";
-		break;
-	case OpCode::Mult:
-		ostream << "Mult";
-		break;
-	case OpCode::Input:
-		ostream << "Input";
-		break;
-	case OpCode::Output:
-		ostream << "Output";
-		break;
-	case OpCode::JumpTrue:
-		ostream << "JumpTrue";
-		break;
-	case OpCode::JumpFalse:
-		ostream << "JumpFalse";
-		break;
-	case OpCode::LessThan:
-		ostream << "LessThan";
-		break;
-	case OpCode::Equals:
-		ostream << "Equals";
-		break;
-	case OpCode::Halt:
-		ostream << "Halt";
-		break;
-	default:
-		ostream << "UNKNOWN("  << (int)opCode << ")";
-	}
-	return ostream;
-}
-
-int
-numParams( OpCode opCode )
-{
-	switch (opCode)
-	{
-	case OpCode::Add:
-	case OpCode::Mult:
-		return 3;
-	case OpCode::Input:
-	case OpCode::Output:
-		return 1;
-	case OpCode::JumpTrue:
-	case OpCode::JumpFalse:
-		return 2;
-	case OpCode::LessThan:
-	case OpCode::Equals:
-		return 3;
-	case OpCode::Halt:
-		return 0;
+		if (last)
+		{
+			*last = *value;
+		}
+		scheduler.send(to, *value);
 	}
-	return 0;
 }
 
-enum class ParameterMode : uint8_t
+// Searches the permutations of a set of phases as a trie, in
+// next_permutation order. Each amplifier is forked from a machine that has
+// already consumed its phase, and the amplifiers of a prefix are run on
+// their first signal once and shared by every permutation that extends it.
+// Only feedback mode needs the snapshots after that; otherwise the signal
+// leaving the prefix is all that is kept.
+struct PhaseTrie
 {
-	Position = 0,
-	Value    = 1
+	// One per phase, each waiting for its first signal.
+	Amplifiers         m_primed;
+	Phases             m_phases;
+	bool               m_feedback{};
+	Mode               m_mode{Mode::Turns};
+	std::vector<bool>  m_used;
+	Phases             m_prefix;
+	Amplifiers         m_chain;
+	Phases             m_bestPhases;
+	std::optional<int> m_bestSignal;
 };
 
-std::ostream&
-operator<<(std::ostream& ostream, const ParameterMode& mode)
+// Runs forks of a chain that has had its first round until the last
+// amplifier halts. With coroutines, one per amplifier relays its outputs
+// to the next, and a machine only runs once it has input to go on with.
+// Pipelined, every amplifier runs on its own thread and
+// the signal flows around the loop through queues. On a Network the
+// amplifiers are chained and this thread closes the loop, handing the last
+// one's outputs back to the first whenever the network stops for want of
+// input. Otherwise they take turns on this one.
+int
+feedbackSignal(Amplifiers& chain, int signal, Mode mode)
 {
-	switch (mode)
+	if (mode == Mode::Coroutines)
 	{
-	case ParameterMode::Position:
-		ostream << "Position";
-		break;
-	case ParameterMode::Value:
-		ostream << "Value";
-		break;
+		std::vector<Runtime> machines;
+		for ( auto& amplifier : chain )
+		{
+			machines.push_back(amplifier.promote<ProgramValue>());
+		}
+		ProgramValue  last = signal;
+		HostScheduler scheduler;
+		for ( size_t i = 0; i < machines.size(); ++i )
+		{
+			bool final = i + 1 == machines.size();
+			scheduler.spawn(relay(scheduler, machines[i], machines[(i + 1) % machines.size()],
+			                      final ? &last : nullptr));
+		}
+		scheduler.send(machines.front(), signal);
+		scheduler.run();
+		return static_cast<int>(last);
 	}
-	return ostream;
-}
-
-struct Parameter
-{
-	int           m_value{};
-	ParameterMode m_mode{ParameterMode::Position};
-};
-
-std::ostream&
-operator<<(std::ostream& ostream, const Parameter& parameter)
-{
-	ostream << "(" << parameter.m_value << "," << parameter.m_mode << ")";
-	return ostream;
-}
-using Parameters = std::vector<Parameter>;
-
-struct Instruction
-{
-	OpCode m_opCode{OpCode::Halt};
-	Parameters m_parameters;
-};
-
-std::ostream&
-operator<<(std::ostream& ostream, const Instruction& instruction)
-{
-	ostream << "[ " << instruction.m_opCode ;
-	for ( const auto& param : instruction.m_parameters )
+	if (mode == Mode::Network)
 	{
-		ostream << param << " ";
+		Network network(chain.size());
+		for ( size_t i = 0; i < chain.size(); ++i )
+		{
+			network.add(chain[i].promote<ProgramValue>());
+			if (i > 0)
+			{
+				network.connect(i - 1, i);
+			}
+		}
+		Runtime& first = network.machine(0);
+		Runtime& last  = network.machine(chain.size() - 1);
+		first.addInput(signal);
+		for (bool halted = false; !halted;)
+		{
+			halted = network.run();
+			if (last.pendingOutputs() == 0)
+			{
+				break;
+			}
+			while (auto output = last.getOutput())
+			{
+				signal = static_cast<int>(*output);
+				first.addInput(*output);
+			}
+		}
+		return signal;
 	}
-	ostream << "]";
-
-	return ostream;
-}
 
-class Runtime
-{
-public:
-	enum class State
+	Amplifiers amplifiers;
+	for ( auto& amplifier : chain )
 	{
-		Initialized,
-		Running,
-		AwaitingInput,
-		Halted
-	};
-	Runtime(Program program):
-		m_program(std::move(program))
-	{}
-	void run();
-	bool isHalted() const;
-	void addInput(int);
-	int  getOutput();
-private:
-	Instruction nextInstruction();
-	void executeInstruction(const Instruction& instruction);
-	int getParameter(const Parameter& parameter);
-
-	Program m_program{};
-	int m_instructionPointer{};
-	State m_state{State::Initialized};
-	std::vector<int> m_inputQueue;
-	std::vector<int> m_outputQueue;
-};
-
-void
-Runtime::run()
-{
-	m_state = State::Running;
-	while( m_state == State::Running )
+		amplifiers.push_back(amplifier.fork());
+	}
+	if (mode == Mode::Pipelined)
 	{
-		Instruction instruction = nextInstruction();
-		std::cout << instruction << std::endl;
-		executeInstruction(instruction);
+		amplifiers.front().addInput(signal);
+		auto outputs = pipeline::run(amplifiers, true);
+		// A chain whose last amplifier halts without output passes the
+		// signal through unchanged.
+		return outputs.empty() ? signal : outputs.back();
 	}
+	while (! amplifiers.back().isHalted() )
+	{
+		for ( auto& amplifier : amplifiers )
+		{
+			amplifier.addInput(signal);
+			amplifier.run();
+			signal = *amplifier.getOutput();
+		}
+	}
+	return signal;
 }
 
-bool
-Runtime::isHalted() const
-{
-	return m_state == State::Halted;
-}
+void search(PhaseTrie& trie, int signal);
 
+// Runs the amplifier for phase i on the signal and searches every
+// permutation continuing from it.
 void
-Runtime::addInput(int value)
-{
-	m_inputQueue.push_back(value);
-}
-
-int
-Runtime::getOutput()
+extend(PhaseTrie& trie, size_t i, int signal)
 {
-	int value = m_outputQueue.front();
-	m_outputQueue.erase(m_outputQueue.begin());
-	return value;
-}
+	Runtime32 amplifier = trie.m_primed[i].fork();
+	amplifier.addInput(signal);
+	amplifier.run();
+	int output = *amplifier.getOutput();
 
-Instruction
-Runtime::nextInstruction()
-{
-	Instruction ret{};
-	int instruction = m_program[m_instructionPointer++];
-	ret.m_opCode = static_cast<OpCode>(instruction % 100);
-	instruction = instruction / 100;
-	ret.m_parameters.resize( numParams(ret.m_opCode) );
-	for ( auto& param : ret.m_parameters )
+	trie.m_used[i] = true;
+	trie.m_prefix.push_back(trie.m_phases[i]);
+	if (trie.m_feedback)
 	{
-		int value = m_program[m_instructionPointer++];
-		ParameterMode parameterMode = static_cast<ParameterMode>(instruction % 10);
-		param = Parameter{value, parameterMode};
-		instruction = instruction / 10;
+		trie.m_chain.push_back(std::move(amplifier));
 	}
-	return ret;
+	search(trie, output);
+	if (trie.m_feedback)
+	{
+		trie.m_chain.pop_back();
+	}
+	trie.m_prefix.pop_back();
+	trie.m_used[i] = false;
 }
 
 void
-Runtime::executeInstruction(const Instruction& instruction)
+search(PhaseTrie& trie, int signal)
 {
-	auto& params = instruction.m_parameters;
-	switch ( instruction.m_opCode )
+	if (trie.m_prefix.size() == trie.m_phases.size())
 	{
-	case OpCode::Add:
-		m_program[ params[2].m_value ] =
-			getParameter(params[0]) + getParameter(params[1]);
-		break;
-	case OpCode::Mult:
-		m_program[ params[2].m_value ] =
-			getParameter(params[0]) * getParameter(params[1]);
-		break;
-	case OpCode::Input:
-		if ( m_inputQueue.empty() )
-		{
-			m_instructionPointer -= 2;
-			m_state = State::AwaitingInput;
-		}
-		else
+		if (trie.m_feedback)
 		{
-			m_program[ params[0].m_value ] = m_inputQueue.front();
-			m_inputQueue.erase(m_inputQueue.begin());
+			signal = feedbackSignal(trie.m_chain, signal, trie.m_mode);
 		}
-		break;
-	case OpCode::Output:
-		m_outputQueue.push_back(getParameter(params[0]));
-		break;
-	case OpCode::JumpTrue:
-		if ( getParameter(params[0]) != 0 )
+		if (!trie.m_bestSignal || signal >= *trie.m_bestSignal)
 		{
-			m_instructionPointer = getParameter(params[1]);
+			trie.m_bestPhases = trie.m_prefix;
+			trie.m_bestSignal = signal;
 		}
-		break;
-	case OpCode::JumpFalse:
-		if ( getParameter(params[0]) == 0 )
+		return;
+	}
+	for ( size_t i = 0; i < trie.m_phases.size(); ++i )
+	{
+		if (!trie.m_used[i])
 		{
-			m_instructionPointer = getParameter(params[1]);
+			extend(trie, i, signal);
 		}
-		break;
-	case OpCode::LessThan:
-		m_program[params[2].m_value] =
-			( getParameter(params[0]) < getParameter(params[1]) ) ? 1 : 0;
-		break;
-	case OpCode::Equals:
-		m_program[params[2].m_value] =
-			( getParameter(params[0]) == getParameter(params[1]) ) ? 1 : 0;
-		break;
-	case OpCode::Halt:
-		m_state = State::Halted;
-		break;
 	}
 }
 
-int
-Runtime::getParameter(const Parameter& parameter)
+// The subtrees under each first phase are searched in parallel. fork() is
+// not safe to call concurrently on one machine, so every subtree gets its
+// own primed machines up front. Pipelined and networked chains bring their
+// own threads, so their subtrees are searched one at a time.
+std::optional<std::pair<Phases, int>>
+bestPhases(const Program& program, Phases phases, bool feedback, Mode mode = Mode::Turns)
 {
-	if ( parameter.m_mode == ParameterMode::Position )
-	{
-		return m_program[parameter.m_value];
-	}
-	else
+	std::sort(phases.begin(), phases.end());
+	Runtime32 image(program);
+	std::vector<PhaseTrie> tries(phases.size());
+	for ( size_t first = 0; first < phases.size(); ++first )
 	{
-		return parameter.m_value;
+		PhaseTrie& trie = tries[first];
+		for ( int phase : phases )
+		{
+			trie.m_primed.push_back(image.fork());
+			trie.m_primed.back().addInput(phase);
+			trie.m_primed.back().run();
+		}
+		trie.m_phases    = phases;
+		trie.m_feedback  = feedback;
+		trie.m_mode      = mode;
+		trie.m_used.assign(phases.size(), false);
 	}
-}
 
-std::vector<int> loadProgram(const std::string& fileName)
-{
-	Program program;
-	std::ifstream programFile(fileName);
-	std::string programLine;
-	std::getline(programFile, programLine);
-	std::istringstream programLineStream(programLine);
-	std::array<char, 64> token;
-	while (programLineStream.getline(&token[0], 64, ','))
+	bool threaded = mode == Mode::Pipelined || mode == Mode::Network;
+	WorkStealingPool pool(threaded ? 1 : std::thread::hardware_concurrency());
+	auto best = sweep::argMax(
+		pool, phases.size(),
+		[](size_t first) { return first; },
+		[&](size_t first) {
+			extend(tries[first], first, 0);
+			return *tries[first].m_bestSignal;
+		});
+	if (!best)
 	{
-		program.push_back( std::stoi(&token[0] ));
-		std::cout << &token[0] << ",";
+		return {};
 	}
-	std::cout << std::endl;
-	return program;
+	return std::make_pair(tries[best->first].m_bestPhases, best->second);
 }
 
-using Phases = std::vector<int>;
-
 int
-getSignal(const Program& program, Phases phases)
+main(int argc, char** argv)
 {
-	std::vector<Runtime> amplifiers(5, program);
-	for ( auto& amplifier : amplifiers )
+	Mode mode = Mode::Turns;
+	if (argc == 2 && std::strcmp(argv[1], "--coroutines") == 0)
 	{
-		amplifier.addInput(phases.front());
-		phases.erase(phases.begin());
+		mode = Mode::Coroutines;
 	}
-	int nextInput = 0;
-	while (! amplifiers[1].isHalted() )
+	else if (argc == 2 && std::strcmp(argv[1], "--pipelined") == 0)
 	{
-		for ( auto& amplifier : amplifiers )
-		{
-			amplifier.addInput(nextInput);
-			amplifier.run();
-			nextInput = amplifier.getOutput();
-		}
+		mode = Mode::Pipelined;
+	}
+	else if (argc == 2 && std::strcmp(argv[1], "--network") == 0)
+	{
+		mode = Mode::Network;
 	}
-	return nextInput;
-}
-
-int
-main()
-{
 	auto program = loadProgram("Day7.input.txt");
-	Phases phases = {5,6,7,8,9};
-	Phases maxPhases = phases;
-	int maxSignal = 0;
-	do {
-		int signal = getSignal(program, phases);
-		if ( signal >= maxSignal )
-		{
-			maxPhases = phases;
-			maxSignal = signal;
-		}
-	} while (std::next_permutation(phases.begin(), phases.end()));
+	auto best = bestPhases(program, {5,6,7,8,9}, true, mode);
+	Phases maxPhases = best->first;
+	int maxSignal = best->second;
 	std::cout << "Phases ";
 	for ( int phase : maxPhases )
 	{
@@ -351,4 +265,4 @@ main()
 	}
 	std::cout << std::endl;
 	std::cout << "Signal " << maxSignal << std::endl;
-}
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#include "CompiledRuntime.h"
+
+#include <iostream>
+
+int
+main()
+{
+	CompiledRuntime runtime;
+	runtime.addInput(2);
+	runtime.run();
+	while (auto output = runtime.getOutput())
+	{
+		std::cout << *output << ",";
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,1790 @@
+#include "Intcode.h"
+#include "Checkpoint.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+std::ostream&
+operator<<(std::ostream& ostream, const OpCode& opCode)
+{
+	switch (opCode)
+	{
+	case OpCode::Add:
+		ostream << "Add";
+		break;
+	case OpCode::Mult:
+		ostream << "Mult";
+		break;
+	case OpCode::Input:
+		ostream << "Input";
+		break;
+	case OpCode::Output:
+		ostream << "Output";
+		break;
+	case OpCode::JumpTrue:
+		ostream << "JumpTrue";
+		break;
+	case OpCode::JumpFalse:
+		ostream << "JumpFalse";
+		break;
+	case OpCode::LessThan:
+		ostream << "LessThan";
+		break;
+	case OpCode::Equals:
+		ostream << "Equals";
+		break;
+	case OpCode::NudgeRelativeBase:
+		ostream << "NudgeRelativeBase";
+		break;
+	case OpCode::Halt:
+		ostream << "Halt";
+		break;
+	default:
+		ostream << "UNKNOWN(" << (int)opCode << ")";
+	}
+	return ostream;
+}
+
+int
+numParams(OpCode opCode)
+{
+	switch (opCode)
+	{
+	case OpCode::Halt:
+		return 0;
+	case OpCode::Input:
+	case OpCode::Output:
+	case OpCode::NudgeRelativeBase:
+		return 1;
+	case OpCode::JumpTrue:
+	case OpCode::JumpFalse:
+		return 2;
+	case OpCode::Add:
+	case OpCode::Mult:
+	case OpCode::LessThan:
+	case OpCode::Equals:
+		return 3;
+	}
+	return 0;
+}
+
+bool
+isKnownOpCode(OpCode opCode)
+{
+	switch (opCode)
+	{
+	case OpCode::Add:
+	case OpCode::Mult:
+	case OpCode::Input:
+	case OpCode::Output:
+	case OpCode::JumpTrue:
+	case OpCode::JumpFalse:
+	case OpCode::LessThan:
+	case OpCode::Equals:
+	case OpCode::NudgeRelativeBase:
+	case OpCode::Halt:
+		return true;
+	}
+	return false;
+}
+
+bool
+writesParameter(OpCode opCode, int parameter)
+{
+	switch (opCode)
+	{
+	case OpCode::Add:
+	case OpCode::Mult:
+	case OpCode::LessThan:
+	case OpCode::Equals:
+		return parameter == 2;
+	case OpCode::Input:
+		return parameter == 0;
+	default:
+		return false;
+	}
+}
+
+std::ostream&
+operator<<(std::ostream& ostream, const ParameterMode& mode)
+{
+	switch (mode)
+	{
+	case ParameterMode::Position:
+		ostream << "Position";
+		break;
+	case ParameterMode::Value:
+		ostream << "Value";
+		break;
+	case ParameterMode::RelativePosition:
+		ostream << "RelativePosition";
+		break;
+	default:
+		ostream << "UNKNOWN(" << (int)mode << ")";
+	}
+	return ostream;
+}
+
+std::ostream&
+operator<<(std::ostream& ostream, WideValue value)
+{
+	// iostreams have no 128-bit overload; print digits least significant first.
+	if (value >= INT64_MIN && value <= INT64_MAX)
+	{
+		return ostream << static_cast<int64_t>(value);
+	}
+	char  digits[40];
+	char* end   = digits + sizeof(digits);
+	char* first = end;
+	bool  minus = value < 0;
+	do
+	{
+		int digit = static_cast<int>(value % 10);
+		*--first  = static_cast<char>('0' + (minus ? -digit : digit));
+		value /= 10;
+	} while (value != 0);
+	if (minus)
+	{
+		*--first = '-';
+	}
+	return ostream.write(first, end - first);
+}
+
+template <typename Word>
+std::ostream&
+operator<<(std::ostream& ostream, const BasicParameter<Word>& parameter)
+{
+	ostream << "(" << parameter.m_value << "," << parameter.m_mode << ")";
+	return ostream;
+}
+
+template <typename Word>
+std::ostream&
+operator<<(std::ostream& ostream, const BasicInstruction<Word>& instruction)
+{
+	ostream << "[ " << instruction.m_opCode;
+	for (int i = 0; i < instruction.m_numParameters; ++i)
+	{
+		ostream << instruction.m_parameters[i] << " ";
+	}
+	ostream << "]";
+
+	return ostream;
+}
+
+template <typename Word, bool Checked, typename Policy>
+std::ostream&
+operator<<(std::ostream& stream, const BasicRuntime<Word, Checked, Policy>& runtime)
+{
+	stream << "IP: " << runtime.m_instructionPointer << std::endl;
+	stream << "RB: " << runtime.m_relativeBase << std::endl;
+	stream << "State: " << (int)runtime.m_state << std::endl;
+	stream << "Input: ";
+	for (size_t i = 0; i < runtime.m_inputQueue.size(); ++i)
+	{
+		stream << runtime.m_inputQueue[i] << ",";
+	}
+	stream << std::endl;
+	stream << "Output: ";
+	for (size_t i = 0; i < runtime.m_outputQueue.size(); ++i)
+	{
+		stream << runtime.m_outputQueue[i] << ",";
+	}
+	stream << std::endl;
+	stream << "Program: ";
+	for (uint64_t address = 0; address < runtime.m_memory.tableSize(); ++address)
+	{
+		stream << runtime.m_memory.read(address) << ",";
+	}
+	stream << std::endl;
+	return stream;
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::run()
+{
+	m_state = State::Running;
+	switch (m_engine)
+	{
+	case Engine::Switch:
+		runSwitch();
+		break;
+	case Engine::Threaded:
+		runThreaded();
+		break;
+	case Engine::Block:
+		runBlocks();
+		break;
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::State
+BasicRuntime<Word, Checked, Policy>::step()
+{
+	if (m_state != State::Halted)
+	{
+		m_state = State::Running;
+		unprofileStalled(stepSwitch());
+	}
+	return m_state;
+}
+
+template <typename Word, bool Checked, typename Policy>
+BasicRuntime<Word, Checked, Policy>
+BasicRuntime<Word, Checked, Policy>::fork()
+{
+	BasicRuntime forked(m_memory.fork(), m_engine);
+	forked.m_instructionPointer = m_instructionPointer;
+	forked.m_relativeBase       = m_relativeBase;
+	forked.m_immutableCode      = m_immutableCode;
+	forked.m_state              = m_state;
+	forked.m_inputQueue         = m_inputQueue;
+	forked.m_outputQueue        = m_outputQueue;
+	return forked;
+}
+
+template <typename Word, bool Checked, typename Policy>
+const typename BasicRuntime<Word, Checked, Policy>::ProfilerType&
+BasicRuntime<Word, Checked, Policy>::profiler()
+{
+	flushProfile();
+	return m_profiler;
+}
+
+// Adds times executions of the instruction at instructionPointer, with the
+// reads and writes of its operands, relative-mode ones taken from
+// relativeBase.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::profile(const Instruction& instruction,
+                                             Word instructionPointer, int64_t times,
+                                             uint64_t relativeBase)
+{
+	if constexpr (ProfilerType::enabled)
+	{
+		OpCode opCode = instruction.m_opCode;
+		m_profiler.instruction(instructionPointer, static_cast<uint8_t>(opCode), times);
+		for (int i = 0; i < instruction.m_numParameters; ++i)
+		{
+			const auto& parameter = instruction.m_parameters[i];
+			if (parameter.m_mode == ParameterMode::Value)
+			{
+				continue;
+			}
+			uint64_t address = static_cast<uint64_t>(parameter.m_value);
+			if (parameter.m_mode == ParameterMode::RelativePosition)
+			{
+				address += relativeBase;
+			}
+			if (writesParameter(opCode, i))
+			{
+				m_profiler.write(address, times);
+			}
+			else
+			{
+				m_profiler.read(address, times);
+			}
+		}
+	}
+}
+
+// Starts a fresh count at the current relative base.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::restartCounter(const CachedInstruction& entry)
+{
+	if constexpr (ProfilerType::enabled)
+	{
+		auto base = static_cast<uint64_t>(m_relativeBase);
+		entry.m_executions.restart(base);
+		for (int i = 0; i < entry.m_instruction.m_numParameters; ++i)
+		{
+			const auto& parameter = entry.m_instruction.m_parameters[i];
+			if (parameter.m_mode == ParameterMode::RelativePosition)
+			{
+				entry.m_executions.narrow(base, static_cast<uint64_t>(parameter.m_value));
+			}
+		}
+	}
+}
+
+// A profiled block only changes the relative base with immediate values
+// (see compiledBlock()), so each operation runs at the base the block was
+// entered with plus a fixed offset.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::restartCounter(const Block& block)
+{
+	if constexpr (ProfilerType::enabled)
+	{
+		auto     base   = static_cast<uint64_t>(m_relativeBase);
+		uint64_t offset = 0;
+		block.m_executions.restart(base);
+		for (const auto& operation : block.m_operations)
+		{
+			const auto& parameters = operation.m_instruction.m_parameters;
+			for (int i = 0; i < operation.m_instruction.m_numParameters; ++i)
+			{
+				if (parameters[i].m_mode == ParameterMode::RelativePosition)
+				{
+					block.m_executions.narrow(
+					    base, offset + static_cast<uint64_t>(parameters[i].m_value));
+				}
+			}
+			if (operation.m_instruction.m_opCode == OpCode::NudgeRelativeBase)
+			{
+				offset += static_cast<uint64_t>(parameters[0].m_value);
+			}
+		}
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::flushProfile(const CachedInstruction& entry, Word address)
+{
+	if constexpr (ProfilerType::enabled)
+	{
+		profile(entry.m_instruction, address, entry.m_executions.m_count,
+		        entry.m_executions.m_firstBase);
+		restartCounter(entry);
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::flushProfile(const Block& block)
+{
+	if constexpr (ProfilerType::enabled)
+	{
+		uint64_t base = block.m_executions.m_firstBase;
+		for (const auto& operation : block.m_operations)
+		{
+			profile(operation.m_instruction,
+			        operation.m_next - 1 - operation.m_instruction.m_numParameters,
+			        block.m_executions.m_count, base);
+			if (operation.m_instruction.m_opCode == OpCode::NudgeRelativeBase)
+			{
+				base += static_cast<uint64_t>(operation.m_instruction.m_parameters[0].m_value);
+			}
+		}
+		restartCounter(block);
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+const typename BasicRuntime<Word, Checked, Policy>::TracerType&
+BasicRuntime<Word, Checked, Policy>::tracer() const
+{
+	return m_tracer;
+}
+
+// Runs a threaded or block handler, recording the instruction in the trace
+// once it has completed. Without tracing this is just the handler call.
+template <typename Word, bool Checked, typename Policy>
+template <typename Code>
+bool
+BasicRuntime<Word, Checked, Policy>::dispatch(bool (*handler)(BasicRuntime&, const Code&),
+                                              const Code& code)
+{
+	if constexpr (TracerType::enabled)
+	{
+		// Fusion is off when tracing, so a block operation is one
+		// instruction.
+		const Instruction* instruction;
+		if constexpr (std::is_same_v<Code, BlockOperation>)
+		{
+			instruction = &code.m_instruction;
+		}
+		else
+		{
+			instruction = &code;
+		}
+		auto record  = traceBegin(*instruction);
+		bool running = handler(*this, code);
+		if (running || m_state == State::Halted)
+		{
+			traceEnd(record);
+		}
+		if (m_state == State::Halted)
+		{
+			m_tracer.halted();
+		}
+		return running;
+	}
+	else
+	{
+		return handler(*this, code);
+	}
+}
+
+// Captures the instruction and its operands before it executes; the
+// instruction pointer has already moved past it.
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::TraceRecord
+BasicRuntime<Word, Checked, Policy>::traceBegin(const Instruction& instruction) const
+{
+	TraceRecord record;
+	record.m_instructionPointer =
+	    static_cast<uint64_t>(m_instructionPointer - 1 - instruction.m_numParameters);
+	record.m_opCode        = static_cast<uint8_t>(instruction.m_opCode);
+	record.m_numParameters = instruction.m_numParameters;
+	for (int i = 0; i < instruction.m_numParameters; ++i)
+	{
+		const auto& parameter  = instruction.m_parameters[i];
+		Word        address    = parameter.m_value;
+		record.m_parameters[i] = static_cast<int64_t>(parameter.m_value);
+		record.m_modes[i]      = static_cast<uint8_t>(parameter.m_mode);
+		if (parameter.m_mode == ParameterMode::RelativePosition)
+		{
+			address += m_relativeBase;
+		}
+		if (writesParameter(instruction.m_opCode, i))
+		{
+			record.m_operands[i] = static_cast<int64_t>(address);
+		}
+		else if (parameter.m_mode == ParameterMode::Value)
+		{
+			record.m_operands[i] = static_cast<int64_t>(parameter.m_value);
+		}
+		else
+		{
+			record.m_operands[i] = static_cast<int64_t>(m_memory.read(address));
+		}
+	}
+	return record;
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::traceEnd(TraceRecord& record)
+{
+	for (int i = 0; i < record.m_numParameters; ++i)
+	{
+		if (writesParameter(static_cast<OpCode>(record.m_opCode), i))
+		{
+			record.m_hasWritten = true;
+			record.m_written    = static_cast<int64_t>(m_memory.read(record.m_operands[i]));
+		}
+	}
+	m_tracer.record(record);
+}
+
+template <typename Word>
+void
+validateInstruction(const BasicInstruction<Word>& instruction, Word address, Word relativeBase,
+                    uint64_t maxAddress)
+{
+	auto fail    = [&](auto describe) {
+		std::ostringstream message;
+		message << "Intcode: ";
+		describe(message);
+		message << " in " << instruction << " at address " << address;
+		throw std::runtime_error(message.str());
+	};
+	auto inRange = [&](Word value) {
+		return value >= 0 && static_cast<uint64_t>(value) <= maxAddress;
+	};
+
+	if (!inRange(address))
+	{
+		fail([](std::ostream& out) { out << "instruction pointer out of range"; });
+	}
+	if (!isKnownOpCode(instruction.m_opCode))
+	{
+		fail([&](std::ostream& out) {
+			out << "unknown opcode " << static_cast<int>(instruction.m_opCode);
+		});
+	}
+	for (int i = 0; i < instruction.m_numParameters; ++i)
+	{
+		const auto& parameter = instruction.m_parameters[i];
+		Word        target    = parameter.m_value;
+		switch (parameter.m_mode)
+		{
+		case ParameterMode::Value:
+			if (writesParameter(instruction.m_opCode, i))
+			{
+				fail([&](std::ostream& out) {
+					out << "parameter " << i + 1 << " stores through an immediate value";
+				});
+			}
+			break;
+		case ParameterMode::RelativePosition:
+			if (__builtin_add_overflow(target, relativeBase, &target))
+			{
+				fail([&](std::ostream& out) {
+					out << "parameter " << i + 1 << " overflows relative base "
+					    << relativeBase;
+				});
+			}
+			[[fallthrough]];
+		case ParameterMode::Position:
+			if (!inRange(target))
+			{
+				fail([&](std::ostream& out) {
+					out << "parameter " << i + 1 << " addresses " << target
+					    << ", outside 0.." << maxAddress;
+				});
+			}
+			break;
+		default:
+			fail([&](std::ostream& out) {
+				out << "parameter " << i + 1 << " has unknown mode "
+				    << static_cast<int>(parameter.m_mode);
+			});
+		}
+	}
+}
+
+
+// Traps on anything the policy rejects before the instruction runs; the
+// instruction pointer has already moved past it.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::validate(const Instruction& instruction) const
+{
+	validateInstruction(instruction, Word(m_instructionPointer - 1 - instruction.m_numParameters),
+	                    m_relativeBase, Policy::maxAddress);
+}
+
+// Folds every cached instruction and block counter into the profile.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::flushProfile()
+{
+	if constexpr (ProfilerType::enabled)
+	{
+		for (size_t address = 0; address < m_instructionCache.size(); ++address)
+		{
+			if (m_instructionCache[address].m_executions.m_count != 0)
+			{
+				flushProfile(m_instructionCache[address], address);
+			}
+		}
+		for (const auto& block : m_blockCache)
+		{
+			if (block && block->m_executions.m_count != 0)
+			{
+				flushProfile(*block);
+			}
+		}
+	}
+}
+
+// Takes back the operations of a block that were counted when it was
+// entered but did not run because an earlier one stopped the machine or
+// rewrote the block's code, each at the relative base it was counted with.
+// Of a fused pair, the instruction pointer tells which part did so: it is
+// left on an incomplete instruction, or just past one that wrote code.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::unprofileRest(const Block& block, const BlockOperation& last,
+                                                   bool lastIncomplete)
+{
+	const BlockOperation* first = &last + last.m_length;
+	for (const BlockOperation* part = &last; part != &last + last.m_length; ++part)
+	{
+		Word address = part->m_next - 1 - part->m_instruction.m_numParameters;
+		if (lastIncomplete ? address == m_instructionPointer : part->m_next == m_instructionPointer)
+		{
+			first = lastIncomplete ? part : part + 1;
+			break;
+		}
+	}
+
+	auto                  base = static_cast<uint64_t>(m_relativeBase);
+	const BlockOperation* end  = block.m_operations.data() + block.m_operations.size();
+	for (const BlockOperation* operation = first; operation != end; ++operation)
+	{
+		profile(operation->m_instruction,
+		        operation->m_next - 1 - operation->m_instruction.m_numParameters, -1, base);
+		if (operation->m_instruction.m_opCode == OpCode::NudgeRelativeBase)
+		{
+			base += static_cast<uint64_t>(operation->m_instruction.m_parameters[0].m_value);
+		}
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::setEngine(Engine engine)
+{
+	m_engine = engine;
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::runSwitch()
+{
+	const Instruction* last = nullptr;
+	while (m_state == State::Running)
+	{
+		last = &stepSwitch();
+	}
+	if (last)
+	{
+		unprofileStalled(*last);
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+const typename BasicRuntime<Word, Checked, Policy>::Instruction&
+BasicRuntime<Word, Checked, Policy>::stepSwitch()
+{
+	const Instruction& instruction = nextInstruction();
+	if constexpr (TracerType::enabled)
+	{
+		auto record = traceBegin(instruction);
+		executeInstruction(instruction);
+		if (m_state == State::Running || m_state == State::Halted)
+		{
+			traceEnd(record);
+		}
+		if (m_state == State::Halted)
+		{
+			m_tracer.halted();
+		}
+	}
+	else
+	{
+		executeInstruction(instruction);
+	}
+	return instruction;
+}
+
+// Takes back the count of an instruction that stopped to be rerun: an Input
+// waiting for a value, or one that overflowed. Left to the engines' callers
+// so that the check is not paid per instruction.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::unprofileStalled(const Instruction& instruction)
+{
+	if constexpr (ProfilerType::enabled)
+	{
+		if (m_state == State::AwaitingInput || m_state == State::Overflowed)
+		{
+			profile(instruction, m_instructionPointer, -1, static_cast<uint64_t>(m_relativeBase));
+		}
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::runThreaded()
+{
+	for (;;)
+	{
+		const CachedInstruction& entry = cachedInstruction();
+		m_instructionPointer += 1 + entry.m_instruction.m_numParameters;
+		if (!dispatch(entry.m_handler, entry.m_instruction))
+		{
+			unprofileStalled(entry.m_instruction);
+			break;
+		}
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::runBlocks()
+{
+	for (;;)
+	{
+		if (!m_retiredBlocks.empty())
+		{
+			m_retiredBlocks.clear();
+		}
+		m_blockInvalidated = false;
+		Block& block       = compiledBlock();
+		if constexpr (ProfilerType::enabled)
+		{
+			if (!block.m_executions.holds(static_cast<uint64_t>(m_relativeBase))) [[unlikely]]
+			{
+				flushProfile(block);
+			}
+		}
+		++block.m_executions;
+		if constexpr (fuses)
+		{
+			if (block.m_visits < fuseAfterVisits && ++block.m_visits == fuseAfterVisits)
+			{
+				fuse(block);
+			}
+		}
+		const BlockOperation* end = block.m_operations.data() + block.m_operations.size();
+		for (const BlockOperation* operation = block.m_operations.data(); operation != end;
+		     operation += operation->m_length)
+		{
+			m_instructionPointer = operation->m_next;
+			if (!dispatch(operation->m_handler, *operation))
+			{
+				if constexpr (ProfilerType::enabled)
+				{
+					unprofileRest(block, *operation, m_state != State::Halted);
+				}
+				return;
+			}
+			if (m_blockInvalidated)
+			{
+				if constexpr (ProfilerType::enabled)
+				{
+					unprofileRest(block, *operation, false);
+				}
+				break;
+			}
+		}
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::Block&
+BasicRuntime<Word, Checked, Policy>::compiledBlock()
+{
+	// Blocks outside the cached range are rebuilt on every visit and kept to
+	// one instruction, since their code is not tracked for invalidation.
+	bool  cached = reserveCode(m_instructionPointer);
+	auto& block  = cached ? m_blockCache[m_instructionPointer] : m_retiredBlocks.emplace_back();
+	if (block)
+	{
+		return *block;
+	}
+
+	block               = std::make_unique<Block>();
+	Block& result       = *block;
+	Word   address      = m_instructionPointer;
+	for (int i = 0; i < (cached ? maxBlockOperations : 1); ++i)
+	{
+		// A cached block stops at the end of the cached range, so that every
+		// word it was built from is tracked for invalidation.
+		if (i > 0 && !reserveCode(address))
+		{
+			break;
+		}
+		BlockOperation operation;
+		operation.m_instruction = decodeInstruction(address);
+		operation.m_handler     = blockHandlerFor(operation.m_instruction);
+		operation.m_next = address + 1 + operation.m_instruction.m_numParameters;
+		result.m_operations.push_back(operation);
+		address = operation.m_next;
+
+		// A profiled block also ends where the relative base changes by an
+		// amount only known at run time; see restartCounter().
+		OpCode opCode = operation.m_instruction.m_opCode;
+		if (opCode == OpCode::JumpTrue || opCode == OpCode::JumpFalse ||
+		    opCode == OpCode::Input || opCode == OpCode::Halt ||
+		    (ProfilerType::enabled && opCode == OpCode::NudgeRelativeBase &&
+		     operation.m_instruction.m_parameters[0].m_mode != ParameterMode::Value) ||
+		    !isKnownOpCode(opCode))
+		{
+			break;
+		}
+	}
+	result.m_end = address;
+	restartCounter(result);
+	if (!cached)
+	{
+		// Counted here because retired blocks are never folded into the
+		// profile.
+		profile(result.m_operations.front().m_instruction, m_instructionPointer, 1,
+		        static_cast<uint64_t>(m_relativeBase));
+	}
+	if (cached)
+	{
+		// reserveCode() covered every operation's parameters too.
+		std::fill(m_isCode.begin() + m_instructionPointer,
+		          m_isCode.begin() + address, 1);
+	}
+	return result;
+}
+
+// Rewrites a hot block so that each pair with a superinstruction runs as
+// one operation: a compare and the conditional jump that tests its result,
+// or two Adds accumulating into the same cell. Within a block a pair runs
+// exactly as often as the block, so its visit count is the pair's profile.
+// The second operation stays behind the first for the fused handler to
+// read, and the block is still dropped whole when its code is written.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::fuse(Block& block)
+{
+	auto& operations = block.m_operations;
+	for (size_t i = 0; i + 1 < operations.size(); ++i)
+	{
+		if (BlockHandler handler =
+		        fusedHandlerFor(operations[i].m_instruction, operations[i + 1].m_instruction))
+		{
+			operations[i].m_handler = handler;
+			operations[i].m_length  = 2;
+			++i;
+		}
+	}
+}
+
+// Grows the per-address code caches to cover an instruction starting at
+// address; returns false if the address is beyond the cached range.
+template <typename Word, bool Checked, typename Policy>
+bool
+BasicRuntime<Word, Checked, Policy>::reserveCode(Word address)
+{
+	if (address < 0 || address >= maxCachedAddress)
+	{
+		return false;
+	}
+	if (static_cast<size_t>(address) + maxParams >= m_isCode.size())
+	{
+		// Grown geometrically from what has executed so far, so a fresh fork
+		// does not pay for the whole image up front.
+		size_t size = std::max<size_t>(2 * m_isCode.size(), address + maxParams + 1);
+		m_instructionCache.resize(size);
+		m_blockCache.resize(size);
+		m_isCode.resize(size);
+	}
+	return true;
+}
+
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::State
+BasicRuntime<Word, Checked, Policy>::state() const
+{
+	return m_state;
+}
+
+template <typename Word, bool Checked, typename Policy>
+bool
+BasicRuntime<Word, Checked, Policy>::isHalted() const
+{
+	return m_state == State::Halted;
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::setRegisters(Word instructionPointer, Word relativeBase)
+{
+	m_instructionPointer = instructionPointer;
+	m_relativeBase       = relativeBase;
+	m_immutableCode      = false;
+	m_state              = State::Initialized;
+}
+
+template <typename Word, bool Checked, typename Policy>
+Word
+BasicRuntime<Word, Checked, Policy>::instructionPointer() const
+{
+	return m_instructionPointer;
+}
+
+template <typename Word, bool Checked, typename Policy>
+Word
+BasicRuntime<Word, Checked, Policy>::relativeBase() const
+{
+	return m_relativeBase;
+}
+
+template <typename Word, bool Checked, typename Policy>
+Word
+BasicRuntime<Word, Checked, Policy>::read(Word address) const
+{
+	return m_memory.read(address);
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::write(Word address, Word value)
+{
+	m_memory.write(address, value);
+	if (!m_immutableCode)
+	{
+		invalidateCode(address);
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::setImmutableCode(bool immutable)
+{
+	m_immutableCode = immutable;
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::addInput(Word value)
+{
+	m_inputQueue.push(value);
+}
+
+template <typename Word, bool Checked, typename Policy>
+size_t
+BasicRuntime<Word, Checked, Policy>::pendingInputs() const
+{
+	return m_inputQueue.size();
+}
+
+template <typename Word, bool Checked, typename Policy>
+std::optional<Word>
+BasicRuntime<Word, Checked, Policy>::getOutput()
+{
+	if (!m_outputQueue.empty())
+	{
+		return m_outputQueue.pop();
+	}
+	return {};
+}
+
+template <typename Word, bool Checked, typename Policy>
+size_t
+BasicRuntime<Word, Checked, Policy>::pendingOutputs() const
+{
+	return m_outputQueue.size();
+}
+
+template <typename Word, bool Checked, typename Policy>
+size_t
+BasicRuntime<Word, Checked, Policy>::drainOutputs(std::span<Word> outputs)
+{
+	return m_outputQueue.pop(outputs.data(), outputs.size());
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::checkpoint(const std::string& fileName)
+{
+	CheckpointRecord record;
+	record.m_state   = static_cast<uint64_t>(m_state);
+	record.m_flags   = m_immutableCode ? checkpointImmutableCode : 0;
+	record.m_inputs  = m_inputQueue.size();
+	record.m_outputs = m_outputQueue.size();
+
+	auto addWord = [&](Word value) {
+		const std::byte* bytes = reinterpret_cast<const std::byte*>(&value);
+		record.m_words.insert(record.m_words.end(), bytes, bytes + sizeof(Word));
+	};
+	addWord(m_instructionPointer);
+	addWord(m_relativeBase);
+	for (size_t i = 0; i < m_inputQueue.size(); ++i)
+	{
+		addWord(m_inputQueue[i]);
+	}
+	for (size_t i = 0; i < m_outputQueue.size(); ++i)
+	{
+		addWord(m_outputQueue[i]);
+	}
+	auto addPage = [&](uint64_t first, const typename PagedMemory<Word>::Page& page) {
+		record.m_pages.emplace_back(first >> PagedMemory<Word>::pageBits,
+		                            reinterpret_cast<const std::byte*>(page.data()));
+	};
+
+	bool full = fileName != m_checkpointFile;
+	if (full)
+	{
+		m_memory.forEachPage(addPage);
+	}
+	else
+	{
+		m_memory.forEachDirtyPage(addPage);
+	}
+	writeCheckpoint(fileName, sizeof(Word), sizeof(typename PagedMemory<Word>::Page), record, full);
+	m_memory.clearDirty();
+	m_checkpointFile = fileName;
+}
+
+template <typename Word, bool Checked, typename Policy>
+BasicRuntime<Word, Checked, Policy>
+BasicRuntime<Word, Checked, Policy>::restore(const std::string& fileName, Engine engine)
+{
+	using Page = typename PagedMemory<Word>::Page;
+
+	auto image = std::make_shared<CheckpointImage>(fileName, sizeof(Word), sizeof(Page));
+	const CheckpointRecord& record = image->latest();
+	if (record.m_state > static_cast<uint64_t>(State::Overflowed))
+	{
+		throw std::runtime_error(fileName + ": checkpoint: bad state");
+	}
+
+	// Every page shares ownership of the image; the mapping is copy-on-write,
+	// so a page this machine holds alone may be written in place.
+	PagedMemory<Word> memory;
+	for (const auto& [page, contents] : record.m_pages)
+	{
+		memory.adopt(page, std::shared_ptr<Page>(image, reinterpret_cast<Page*>(
+		                                                     const_cast<std::byte*>(contents))));
+	}
+	BasicRuntime restored(std::move(memory), engine);
+
+	const std::byte* words = record.m_words.data();
+	auto getWord = [&] {
+		Word value;
+		std::memcpy(&value, words, sizeof(Word));
+		words += sizeof(Word);
+		return value;
+	};
+	restored.m_instructionPointer = getWord();
+	restored.m_relativeBase       = getWord();
+	for (uint64_t i = 0; i < record.m_inputs; ++i)
+	{
+		restored.m_inputQueue.push(getWord());
+	}
+	for (uint64_t i = 0; i < record.m_outputs; ++i)
+	{
+		restored.m_outputQueue.push(getWord());
+	}
+	restored.m_state          = static_cast<State>(record.m_state);
+	restored.m_immutableCode  = record.m_flags & checkpointImmutableCode;
+	// Appending after a torn record would hide the new one from restore().
+	restored.m_checkpointFile = image->torn() ? std::string() : fileName;
+	restored.m_memory.clearDirty();
+	return restored;
+}
+
+// Decoding, and instructions outside the cached range, are kept out of
+// cachedInstruction() so that it stays small enough to inline into the
+// engines' loops.
+template <typename Word, bool Checked, typename Policy>
+const typename BasicRuntime<Word, Checked, Policy>::CachedInstruction&
+BasicRuntime<Word, Checked, Policy>::uncachedInstruction()
+{
+	auto& entry         = m_uncachedInstruction;
+	entry.m_instruction = decodeInstruction(m_instructionPointer);
+	entry.m_handler     = handlerFor(entry.m_instruction);
+	profile(entry.m_instruction, m_instructionPointer, 1, static_cast<uint64_t>(m_relativeBase));
+	return entry;
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::decodeCachedInstruction(CachedInstruction& entry)
+{
+	entry.m_instruction = decodeInstruction(m_instructionPointer);
+	entry.m_handler     = handlerFor(entry.m_instruction);
+	entry.m_valid       = true;
+	auto first          = m_isCode.begin() + m_instructionPointer;
+	std::fill(first, first + 1 + entry.m_instruction.m_numParameters, 1);
+	restartCounter(entry);
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::refreshCachedInstruction(CachedInstruction& entry)
+{
+	if (entry.m_valid)
+	{
+		flushProfile(entry, m_instructionPointer);
+	}
+	else
+	{
+		decodeCachedInstruction(entry);
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+const typename BasicRuntime<Word, Checked, Policy>::CachedInstruction&
+BasicRuntime<Word, Checked, Policy>::cachedInstruction()
+{
+	if (!reserveCode(m_instructionPointer))
+	{
+		return uncachedInstruction();
+	}
+	auto& entry = m_instructionCache[m_instructionPointer];
+	if constexpr (ProfilerType::enabled)
+	{
+		// An entry that is not decoded holds no base, so one check covers
+		// both.
+		if (!entry.m_executions.holds(static_cast<uint64_t>(m_relativeBase))) [[unlikely]]
+		{
+			refreshCachedInstruction(entry);
+		}
+	}
+	else if (!entry.m_valid)
+	{
+		decodeCachedInstruction(entry);
+	}
+	++entry.m_executions;
+	return entry;
+}
+
+template <typename Word, bool Checked, typename Policy>
+const typename BasicRuntime<Word, Checked, Policy>::Instruction&
+BasicRuntime<Word, Checked, Policy>::nextInstruction()
+{
+	const Instruction& instruction = cachedInstruction().m_instruction;
+	m_instructionPointer += 1 + instruction.m_numParameters;
+	return instruction;
+}
+
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::Instruction
+BasicRuntime<Word, Checked, Policy>::decodeInstruction(Word address) const
+{
+	return ::decodeInstruction<Word>(m_memory, address);
+}
+
+// A write to an instruction word (opcode or operand) drops just the cached
+// instruction and the compiled blocks that cover it, so self-modifying code
+// is re-decoded. Blocks being executed are retired rather than freed.
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::invalidateCode(Word index)
+{
+	if (static_cast<uint64_t>(index) >= m_isCode.size() || !m_isCode[index])
+	{
+		return;
+	}
+	m_isCode[index] = 0;
+
+	for (Word address = std::max<Word>(0, index - maxParams);
+	     address <= index; ++address)
+	{
+		auto& entry = m_instructionCache[address];
+		if (entry.m_valid &&
+		    address + entry.m_instruction.m_numParameters >= index)
+		{
+			flushProfile(entry, address);
+			entry.m_valid = false;
+			if constexpr (ProfilerType::enabled)
+			{
+				entry.m_executions.clear();
+			}
+		}
+	}
+
+	Word blockSpan = maxBlockOperations * (1 + maxParams);
+	for (Word address = std::max<Word>(0, index - blockSpan);
+	     address <= index; ++address)
+	{
+		auto& block = m_blockCache[address];
+		if (block && block->m_end > index)
+		{
+			flushProfile(*block);
+			m_retiredBlocks.push_back(std::move(block));
+			m_blockInvalidated = true;
+		}
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::executeInstruction(const Instruction& instruction)
+{
+	if constexpr (Policy::validate)
+	{
+		validate(instruction);
+	}
+	auto& params = instruction.m_parameters;
+	switch (instruction.m_opCode)
+	{
+	case OpCode::Add:
+	case OpCode::Mult:
+	{
+		Word result{};
+		bool fits = instruction.m_opCode == OpCode::Add
+		                ? add(getParameter(params[0]), getParameter(params[1]), result)
+		                : multiply(getParameter(params[0]), getParameter(params[1]), result);
+		if (!fits)
+		{
+			overflow(instruction);
+			break;
+		}
+		setParameter(params[2], result);
+		break;
+	}
+	case OpCode::Input:
+		if (m_inputQueue.empty())
+		{
+			m_instructionPointer -= 2;
+			m_state = State::AwaitingInput;
+		}
+		else
+		{
+			m_profiler.io(Profiler::Event::Input, m_instructionPointer - 2);
+			setParameter(params[0], m_inputQueue.pop());
+		}
+		break;
+	case OpCode::Output:
+		m_profiler.io(Profiler::Event::Output, m_instructionPointer - 2);
+		m_outputQueue.push(getParameter(params[0]));
+		break;
+	case OpCode::JumpTrue:
+		if (getParameter(params[0]) != 0)
+		{
+			m_instructionPointer = getParameter(params[1]);
+		}
+		break;
+	case OpCode::JumpFalse:
+		if (getParameter(params[0]) == 0)
+		{
+			m_instructionPointer = getParameter(params[1]);
+		}
+		break;
+	case OpCode::LessThan:
+		setParameter(params[2],
+		             (getParameter(params[0]) < getParameter(params[1])) ? 1 : 0);
+		break;
+	case OpCode::Equals:
+		setParameter(params[2],
+		             (getParameter(params[0]) == getParameter(params[1])) ? 1 : 0);
+		break;
+	case OpCode::NudgeRelativeBase:
+	{
+		// An overflowed change leaves the base as it was for the rerun.
+		Word base{};
+		if (!add(m_relativeBase, getParameter(params[0]), base))
+		{
+			overflow(instruction);
+			break;
+		}
+		m_relativeBase = base;
+		break;
+	}
+	case OpCode::Halt:
+		m_state = State::Halted;
+		profiler().halted();
+		break;
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+void
+BasicRuntime<Word, Checked, Policy>::setParameter(const BasicParameter<Word>& parameter, Word value)
+{
+	Word index = parameter.m_value;
+
+	if (parameter.m_mode == ParameterMode::RelativePosition)
+	{
+		index += m_relativeBase;
+	}
+	m_memory.write(index, value);
+	if (!m_immutableCode)
+	{
+		invalidateCode(index);
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+Word
+BasicRuntime<Word, Checked, Policy>::getParameter(const BasicParameter<Word>& parameter)
+{
+	if (parameter.m_mode != ParameterMode::Value)
+	{
+		Word index = parameter.m_value;
+
+		if (parameter.m_mode == ParameterMode::RelativePosition)
+		{
+			index += m_relativeBase;
+		}
+		return m_memory.read(index);
+	}
+	else
+	{
+		return parameter.m_value;
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+bool
+BasicRuntime<Word, Checked, Policy>::add(Word lhs, Word rhs, Word& result)
+{
+	if constexpr (Checked)
+	{
+		return !__builtin_add_overflow(lhs, rhs, &result);
+	}
+	result = lhs + rhs;
+	return true;
+}
+
+template <typename Word, bool Checked, typename Policy>
+bool
+BasicRuntime<Word, Checked, Policy>::multiply(Word lhs, Word rhs, Word& result)
+{
+	if constexpr (Checked)
+	{
+		return !__builtin_mul_overflow(lhs, rhs, &result);
+	}
+	result = lhs * rhs;
+	return true;
+}
+
+// Rewinds to the instruction that overflowed so a promoted copy of the
+// machine executes it again with wider words.
+template <typename Word, bool Checked, typename Policy>
+bool
+BasicRuntime<Word, Checked, Policy>::overflow(const Instruction& instruction)
+{
+	m_instructionPointer -= 1 + instruction.m_numParameters;
+	m_state = State::Overflowed;
+	return false;
+}
+
+template <typename Word, bool Checked, typename Policy>
+template <ParameterMode Mode>
+Word
+BasicRuntime<Word, Checked, Policy>::load(Word value)
+{
+	if constexpr (Mode == ParameterMode::Value)
+	{
+		return value;
+	}
+	else
+	{
+		Word index = value;
+		if constexpr (Mode == ParameterMode::RelativePosition)
+		{
+			index += m_relativeBase;
+		}
+		return m_memory.read(index);
+	}
+}
+
+template <typename Word, bool Checked, typename Policy>
+template <ParameterMode Mode>
+void
+BasicRuntime<Word, Checked, Policy>::store(Word value, Word result)
+{
+	Word index = value;
+	if constexpr (Mode == ParameterMode::RelativePosition)
+	{
+		index += m_relativeBase;
+	}
+	m_memory.write(index, result);
+	if (!m_immutableCode)
+	{
+		invalidateCode(index);
+	}
+}
+
+// Handler table layout: one slot per OpCode (Halt in slot 0, slot 10 for
+// anything unknown) times every combination of the three parameter modes.
+namespace
+{
+constexpr size_t numOpCodeSlots = 11;
+constexpr size_t numModeCombos  = 27;
+
+constexpr OpCode
+opCodeForSlot(size_t slot)
+{
+	return slot == 0 ? OpCode::Halt : static_cast<OpCode>(slot);
+}
+
+constexpr ParameterMode
+modeForSlot(size_t index, int param)
+{
+	size_t combo = index % numModeCombos;
+	for (int i = 0; i < param; ++i)
+	{
+		combo /= 3;
+	}
+	return static_cast<ParameterMode>(combo % 3);
+}
+} // namespace
+
+template <typename Word, bool Checked, typename Policy>
+template <size_t Index>
+bool
+BasicRuntime<Word, Checked, Policy>::execute(BasicRuntime& runtime, const Instruction& instruction)
+{
+	constexpr size_t        slot = Index / numModeCombos;
+	constexpr OpCode        op   = opCodeForSlot(slot);
+	constexpr ParameterMode m0   = modeForSlot(Index, 0);
+	constexpr ParameterMode m1   = modeForSlot(Index, 1);
+	constexpr ParameterMode m2   = modeForSlot(Index, 2);
+	const auto&             p    = instruction.m_parameters;
+
+	if constexpr (Policy::validate)
+	{
+		runtime.validate(instruction);
+	}
+	if constexpr (slot >= 10)
+	{
+		return true;
+	}
+	else if constexpr (op == OpCode::Add)
+	{
+		Word result;
+		if (!add(runtime.template load<m0>(p[0].m_value),
+		         runtime.template load<m1>(p[1].m_value), result))
+		{
+			return runtime.overflow(instruction);
+		}
+		runtime.template store<m2>(p[2].m_value, result);
+	}
+	else if constexpr (op == OpCode::Mult)
+	{
+		Word result;
+		if (!multiply(runtime.template load<m0>(p[0].m_value),
+		              runtime.template load<m1>(p[1].m_value), result))
+		{
+			return runtime.overflow(instruction);
+		}
+		runtime.template store<m2>(p[2].m_value, result);
+	}
+	else if constexpr (op == OpCode::Input)
+	{
+		if (runtime.m_inputQueue.empty())
+		{
+			runtime.m_instructionPointer -= 2;
+			runtime.m_state = State::AwaitingInput;
+			return false;
+		}
+		runtime.m_profiler.io(Profiler::Event::Input, runtime.m_instructionPointer - 2);
+		runtime.template store<m0>(p[0].m_value, runtime.m_inputQueue.pop());
+	}
+	else if constexpr (op == OpCode::Output)
+	{
+		runtime.m_profiler.io(Profiler::Event::Output, runtime.m_instructionPointer - 2);
+		runtime.m_outputQueue.push(runtime.template load<m0>(p[0].m_value));
+	}
+	else if constexpr (op == OpCode::JumpTrue)
+	{
+		if (runtime.template load<m0>(p[0].m_value) != 0)
+		{
+			runtime.m_instructionPointer = runtime.template load<m1>(p[1].m_value);
+		}
+	}
+	else if constexpr (op == OpCode::JumpFalse)
+	{
+		if (runtime.template load<m0>(p[0].m_value) == 0)
+		{
+			runtime.m_instructionPointer = runtime.template load<m1>(p[1].m_value);
+		}
+	}
+	else if constexpr (op == OpCode::LessThan)
+	{
+		runtime.template store<m2>(p[2].m_value, (runtime.template load<m0>(p[0].m_value) <
+		                                           runtime.template load<m1>(p[1].m_value))
+		                                              ? 1
+		                                              : 0);
+	}
+	else if constexpr (op == OpCode::Equals)
+	{
+		runtime.template store<m2>(p[2].m_value, (runtime.template load<m0>(p[0].m_value) ==
+		                                           runtime.template load<m1>(p[1].m_value))
+		                                              ? 1
+		                                              : 0);
+	}
+	else if constexpr (op == OpCode::NudgeRelativeBase)
+	{
+		Word base;
+		if (!add(runtime.m_relativeBase, runtime.template load<m0>(p[0].m_value), base))
+		{
+			return runtime.overflow(instruction);
+		}
+		runtime.m_relativeBase = base;
+	}
+	else if constexpr (op == OpCode::Halt)
+	{
+		runtime.m_state = State::Halted;
+		runtime.profiler().halted();
+		return false;
+	}
+	return true;
+}
+
+template <typename Word, bool Checked, typename Policy>
+template <size_t... Index>
+constexpr std::array<typename BasicRuntime<Word, Checked, Policy>::Handler, sizeof...(Index)>
+BasicRuntime<Word, Checked, Policy>::makeHandlerTable(std::index_sequence<Index...>)
+{
+	return {&execute<Index>...};
+}
+
+template <typename Word, bool Checked, typename Policy>
+size_t
+BasicRuntime<Word, Checked, Policy>::handlerIndex(const Instruction& instruction)
+{
+	auto   opCode = static_cast<size_t>(instruction.m_opCode);
+	size_t slot   = opCode == static_cast<size_t>(OpCode::Halt) ? 0
+	                : (opCode >= 1 && opCode <= 9)              ? opCode
+	                                                            : 10;
+	size_t combo  = 0;
+	for (int i = maxParams - 1; i >= 0; --i)
+	{
+		// Unknown modes behave like Position in getParameter/setParameter.
+		auto mode = static_cast<size_t>(instruction.m_parameters[i].m_mode);
+		combo     = combo * 3 + (mode <= 2 ? mode : 0);
+	}
+	return slot * numModeCombos + combo;
+}
+
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::Handler
+BasicRuntime<Word, Checked, Policy>::handlerFor(const Instruction& instruction)
+{
+	static constexpr auto table =
+	    makeHandlerTable(std::make_index_sequence<numOpCodeSlots * numModeCombos>{});
+	return table[handlerIndex(instruction)];
+}
+
+template <typename Word, bool Checked, typename Policy>
+template <size_t Index>
+bool
+BasicRuntime<Word, Checked, Policy>::executeOperation(BasicRuntime&         runtime,
+                                                      const BlockOperation& operation)
+{
+	return execute<Index>(runtime, operation.m_instruction);
+}
+
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::BlockHandler
+BasicRuntime<Word, Checked, Policy>::blockHandlerFor(const Instruction& instruction)
+{
+	static constexpr auto table = []<size_t... Index>(std::index_sequence<Index...>) {
+		return std::array<BlockHandler, sizeof...(Index)>{&executeOperation<Index>...};
+	}(std::make_index_sequence<numOpCodeSlots * numModeCombos>{});
+	return table[handlerIndex(instruction)];
+}
+
+// Superinstruction for LessThan or Equals followed by JumpTrue or JumpFalse
+// on the cell it wrote. Index packs (compare, jump, mode 0, mode 1, result
+// mode, target mode), the result mode being Position or RelativePosition.
+template <typename Word, bool Checked, typename Policy>
+template <size_t Index>
+bool
+BasicRuntime<Word, Checked, Policy>::executeCompareBranch(BasicRuntime&         runtime,
+                                                          const BlockOperation& operation)
+{
+	constexpr ParameterMode target = static_cast<ParameterMode>(Index % 3);
+	constexpr ParameterMode m2 = Index / 3 % 2 ? ParameterMode::RelativePosition
+	                                           : ParameterMode::Position;
+	constexpr ParameterMode m1 = static_cast<ParameterMode>(Index / 6 % 3);
+	constexpr ParameterMode m0 = static_cast<ParameterMode>(Index / 18 % 3);
+	constexpr bool jumpIfTrue  = Index / 54 % 2 == 0;
+	constexpr bool lessThan    = Index / 108 == 0;
+	const auto&    p           = operation.m_instruction.m_parameters;
+
+	Word lhs    = runtime.template load<m0>(p[0].m_value);
+	Word rhs    = runtime.template load<m1>(p[1].m_value);
+	bool result = lessThan ? lhs < rhs : lhs == rhs;
+	runtime.template store<m2>(p[2].m_value, result ? 1 : 0);
+	if (runtime.m_blockInvalidated)
+	{
+		// The result landed on code; runBlocks() decodes the jump again.
+		return true;
+	}
+	runtime.m_instructionPointer += 3;
+	if (result == jumpIfTrue)
+	{
+		const auto& jump             = (&operation + 1)->m_instruction.m_parameters;
+		runtime.m_instructionPointer = runtime.template load<target>(jump[1].m_value);
+	}
+	return true;
+}
+
+// Superinstruction for an Add followed by an Add of its result and one more
+// operand into the same cell. Index packs (mode 0, mode 1, result mode,
+// addend mode); the second Add's parameters are ordered so the addend comes
+// second.
+template <typename Word, bool Checked, typename Policy>
+template <size_t Index>
+bool
+BasicRuntime<Word, Checked, Policy>::executeAddChain(BasicRuntime&         runtime,
+                                                     const BlockOperation& operation)
+{
+	constexpr ParameterMode addend = static_cast<ParameterMode>(Index % 3);
+	constexpr ParameterMode m2     = Index / 3 % 2 ? ParameterMode::RelativePosition
+	                                               : ParameterMode::Position;
+	constexpr ParameterMode m1     = static_cast<ParameterMode>(Index / 6 % 3);
+	constexpr ParameterMode m0     = static_cast<ParameterMode>(Index / 18);
+	const auto&             p      = operation.m_instruction.m_parameters;
+
+	Word sum;
+	if (!add(runtime.template load<m0>(p[0].m_value), runtime.template load<m1>(p[1].m_value),
+	         sum))
+	{
+		return runtime.overflow(operation.m_instruction);
+	}
+	runtime.template store<m2>(p[2].m_value, sum);
+	if (runtime.m_blockInvalidated)
+	{
+		return true;
+	}
+	const Instruction& second = (&operation + 1)->m_instruction;
+	runtime.m_instructionPointer += 4;
+	if (!add(sum, runtime.template load<addend>(second.m_parameters[1].m_value), sum))
+	{
+		return runtime.overflow(second);
+	}
+	runtime.template store<m2>(p[2].m_value, sum);
+	return true;
+}
+
+// Returns the superinstruction for a pair, or null if there is none. May
+// swap the second instruction's operands into the order its handler expects.
+template <typename Word, bool Checked, typename Policy>
+typename BasicRuntime<Word, Checked, Policy>::BlockHandler
+BasicRuntime<Word, Checked, Policy>::fusedHandlerFor(const Instruction& first,
+                                                     Instruction&       second)
+{
+	static constexpr auto compareBranch = []<size_t... Index>(std::index_sequence<Index...>) {
+		return std::array<BlockHandler, sizeof...(Index)>{&executeCompareBranch<Index>...};
+	}(std::make_index_sequence<216>{});
+	static constexpr auto addChain = []<size_t... Index>(std::index_sequence<Index...>) {
+		return std::array<BlockHandler, sizeof...(Index)>{&executeAddChain<Index>...};
+	}(std::make_index_sequence<54>{});
+
+	auto mode = [](const BasicParameter<Word>& parameter) {
+		return static_cast<size_t>(parameter.m_mode);
+	};
+	auto sameCell = [](const BasicParameter<Word>& lhs, const BasicParameter<Word>& rhs) {
+		return lhs.m_mode == rhs.m_mode && lhs.m_value == rhs.m_value;
+	};
+	OpCode op   = first.m_opCode;
+	OpCode next = second.m_opCode;
+	if (op != OpCode::Add && op != OpCode::LessThan && op != OpCode::Equals)
+	{
+		return nullptr;
+	}
+	for (int i = 0; i < maxParams; ++i)
+	{
+		if (mode(first.m_parameters[i]) > 2 ||
+		    (i < second.m_numParameters && mode(second.m_parameters[i]) > 2))
+		{
+			return nullptr;
+		}
+	}
+	const auto& p      = first.m_parameters;
+	auto&       q      = second.m_parameters;
+	size_t      result = p[2].m_mode == ParameterMode::RelativePosition;
+	if (p[2].m_mode == ParameterMode::Value)
+	{
+		return nullptr;
+	}
+
+	if (op != OpCode::Add && (next == OpCode::JumpTrue || next == OpCode::JumpFalse) &&
+	    sameCell(p[2], q[0]))
+	{
+		size_t compare = op == OpCode::Equals;
+		size_t jump    = next == OpCode::JumpFalse;
+		size_t index   = ((compare * 2 + jump) * 3 + mode(p[0])) * 3 + mode(p[1]);
+		return compareBranch[(index * 2 + result) * 3 + mode(q[1])];
+	}
+	if (op == OpCode::Add && next == OpCode::Add && sameCell(p[2], q[2]) &&
+	    (sameCell(p[2], q[0]) || sameCell(p[2], q[1])))
+	{
+		if (!sameCell(p[2], q[0]))
+		{
+			std::swap(q[0], q[1]);
+		}
+		return addChain[((mode(p[0]) * 3 + mode(p[1])) * 2 + result) * 3 + mode(q[1])];
+	}
+	return nullptr;
+}
+
+template class BasicRuntime<int32_t>;
+template class BasicRuntime<int32_t, true>;
+template class BasicRuntime<ProgramValue>;
+template class BasicRuntime<ProgramValue, true>;
+template class BasicRuntime<WideValue, true>;
+template class BasicRuntime<ProgramValue, false, TrustedPolicy>;
+template class BasicRuntime<ProgramValue, false, DebugPolicy>;
+
+template void validateInstruction(const BasicInstruction<int32_t>&, int32_t, int32_t, uint64_t);
+template void validateInstruction(const BasicInstruction<ProgramValue>&, ProgramValue, ProgramValue,
+                                  uint64_t);
+template void validateInstruction(const BasicInstruction<WideValue>&, WideValue, WideValue, uint64_t);
+template std::ostream& operator<<(std::ostream&, const BasicParameter<int32_t>&);
+template std::ostream& operator<<(std::ostream&, const BasicInstruction<int32_t>&);
+template std::ostream& operator<<(std::ostream&, const BasicParameter<ProgramValue>&);
+template std::ostream& operator<<(std::ostream&, const BasicInstruction<ProgramValue>&);
+template std::ostream& operator<<(std::ostream&, const BasicParameter<WideValue>&);
+template std::ostream& operator<<(std::ostream&, const BasicInstruction<WideValue>&);
+template std::ostream& operator<<(std::ostream&, const BasicRuntime<int32_t, false>&);
+template std::ostream& operator<<(std::ostream&, const BasicRuntime<int32_t, true>&);
+template std::ostream& operator<<(std::ostream&, const BasicRuntime<ProgramValue, false>&);
+template std::ostream& operator<<(std::ostream&, const BasicRuntime<ProgramValue, true>&);
+template std::ostream& operator<<(std::ostream&, const BasicRuntime<WideValue, true>&);
+template std::ostream& operator<<(std::ostream&, const TrustedRuntime&);
+template std::ostream& operator<<(std::ostream&, const DebugRuntime&);
+
+namespace
+{
+bool
+isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+[[noreturn]] void
+parseError(std::string_view text, const char* at, const std::string& name,
+           const std::string& what)
+{
+	size_t offset    = at - text.data();
+	size_t line      = 1 + std::count(text.begin(), text.begin() + offset, '\n');
+	size_t lineStart = text.substr(0, offset).find_last_of('\n');
+	size_t column    = offset - (lineStart == std::string_view::npos ? 0 : lineStart + 1) + 1;
+	throw std::runtime_error(name + ":" + std::to_string(line) + ":" +
+	                         std::to_string(column) + ": " + what);
+}
+} // namespace
+
+Program
+parseProgram(std::string_view text, const std::string& name)
+{
+	Program program;
+	program.reserve(std::count(text.begin(), text.end(), ',') + 1);
+
+	const char* first = text.data();
+	const char* last  = first + text.size();
+	for (;;)
+	{
+		while (first != last && isSpace(*first))
+		{
+			++first;
+		}
+		if (first == last)
+		{
+			// Empty input, or a trailing comma.
+			break;
+		}
+
+		ProgramValue value{};
+		auto [end, error] = std::from_chars(first, last, value);
+		if (error == std::errc::result_out_of_range)
+		{
+			parseError(text, first, name, "value out of range");
+		}
+		if (error != std::errc())
+		{
+			const char* token = first;
+			while (token != last && *token != ',' && !isSpace(*token))
+			{
+				++token;
+			}
+			parseError(text, first, name,
+			           token == first ? std::string("expected a value")
+			                          : "malformed value '" + std::string(first, token) + "'");
+		}
+		program.push_back(value);
+
+		first = end;
+		while (first != last && isSpace(*first))
+		{
+			++first;
+		}
+		if (first == last)
+		{
+			break;
+		}
+		if (*first != ',')
+		{
+			parseError(text, first, name,
+			           std::string("expected ',' but found '") + *first + "'");
+		}
+		++first;
+	}
+	return program;
+}
+
+Program
+loadProgram(const std::string& fileName)
+{
+	MappedFile file(fileName);
+	return parseProgram(file.text(), fileName);
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+#include "Memory.h"
+#include "RingBuffer.h"
+#include "RuntimePolicy.h"
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using ProgramValue = long long;
+using Program      = std::vector<ProgramValue>;
+using Memory       = PagedMemory<ProgramValue>;
+// Widest word a machine can be promoted to after overflowing 64 bits.
+__extension__ typedef __int128 WideValue;
+
+std::ostream& operator<<(std::ostream& ostream, WideValue value);
+
+enum class OpCode : uint8_t
+{
+	Add               = 1,
+	Mult              = 2,
+	Input             = 3,
+	Output            = 4,
+	JumpTrue          = 5,
+	JumpFalse         = 6,
+	LessThan          = 7,
+	Equals            = 8,
+	NudgeRelativeBase = 9,
+	Halt              = 99
+};
+
+std::ostream& operator<<(std::ostream& ostream, const OpCode& opCode);
+int           numParams(OpCode opCode);
+bool          isKnownOpCode(OpCode opCode);
+// True for the parameter an instruction stores its result through.
+bool          writesParameter(OpCode opCode, int parameter);
+
+enum class ParameterMode : uint8_t
+{
+	Position         = 0,
+	Value            = 1,
+	RelativePosition = 2
+};
+
+std::ostream& operator<<(std::ostream& ostream, const ParameterMode& mode);
+
+template <typename Word>
+struct BasicParameter
+{
+	Word          m_value{};
+	ParameterMode m_mode{ParameterMode::Position};
+};
+
+template <typename Word>
+std::ostream& operator<<(std::ostream& ostream, const BasicParameter<Word>& parameter);
+
+constexpr int maxParams = 3;
+
+template <typename Word>
+using BasicParameters = std::array<BasicParameter<Word>, maxParams>;
+
+// Fixed-size so decoded instructions can be cached without allocating.
+template <typename Word>
+struct BasicInstruction
+{
+	OpCode                m_opCode{OpCode::Halt};
+	uint8_t               m_numParameters{};
+	BasicParameters<Word> m_parameters{};
+};
+
+using Parameter   = BasicParameter<ProgramValue>;
+using Parameters  = BasicParameters<ProgramValue>;
+using Instruction = BasicInstruction<ProgramValue>;
+
+template <typename Word>
+std::ostream& operator<<(std::ostream& ostream, const BasicInstruction<Word>& instruction);
+
+// Works on anything indexable by address, e.g. a Program or a Memory.
+template <typename Word = ProgramValue, typename Source>
+BasicInstruction<Word>
+decodeInstruction(const Source& memory, std::type_identity_t<Word> address)
+{
+	BasicInstruction<Word> ret{};
+	Word                   instruction = memory[address++];
+	ret.m_opCode                       = static_cast<OpCode>(instruction % 100);
+	ret.m_numParameters                = numParams(ret.m_opCode);
+	instruction                        = instruction / 100;
+	for (int i = 0; i < ret.m_numParameters; ++i)
+	{
+		Word          value         = memory[address++];
+		ParameterMode parameterMode = static_cast<ParameterMode>(instruction % 10);
+		ret.m_parameters[i]         = BasicParameter<Word>{value, parameterMode};
+		instruction                 = instruction / 10;
+	}
+	return ret;
+}
+
+// Throws the std::runtime_error a validating machine traps with, naming the
+// instruction and its address, if the instruction decoded at address is
+// invalid with the given relative base; see RuntimePolicy.h. Instantiated
+// in Intcode.cpp for every word type.
+template <typename Word>
+void validateInstruction(const BasicInstruction<Word>& instruction, Word address, Word relativeBase,
+                         uint64_t maxAddress);
+
+// State and engine selection shared by every word type.
+class RuntimeBase
+{
+public:
+	// Overflowed is only reached by checked machines: the instruction whose
+	// result did not fit is left unexecuted, ready to rerun after promote().
+	enum class State
+	{
+		Initialized,
+		Running,
+		AwaitingInput,
+		Halted,
+		Overflowed
+	};
+	// Switch decodes into an Instruction and dispatches on its OpCode;
+	// Threaded binds each cached instruction to a handler specialised for its
+	// (OpCode, ParameterMode...) combination, so no mode checks run per step;
+	// Block compiles straight-line runs of instructions ending in a jump,
+	// input or halt into arrays of those handlers, cached per entry address,
+	// and fuses common pairs in hot blocks into single handlers.
+	enum class Engine
+	{
+		Switch,
+		Threaded,
+		Block
+	};
+};
+
+template <typename Word, bool Checked, typename Policy>
+class BasicRuntime;
+
+template <typename Word, bool Checked, typename Policy>
+std::ostream& operator<<(std::ostream& stream, const BasicRuntime<Word, Checked, Policy>& runtime);
+
+// An Intcode machine whose memory, registers and I/O use Word. Narrow words
+// halve the memory footprint of 64-bit ones; a Checked machine stops in
+// State::Overflowed instead of wrapping when Add, Mult or a relative base
+// change does not fit, so the host can promote() it and carry on. Policy
+// picks the instrumentation and validation compiled in; see RuntimePolicy.h.
+template <typename Word, bool Checked = false, typename Policy = DefaultPolicy>
+class BasicRuntime : public RuntimeBase
+{
+public:
+	using Value        = Word;
+	using Instruction  = BasicInstruction<Word>;
+	using ProfilerType = typename Policy::Profiler;
+	using TracerType   = typename Policy::Tracer;
+
+	// Program values are narrowed to Word; use a wide enough word type.
+	BasicRuntime(const Program& program, Engine engine = Engine::Switch)
+	    : m_memory(program)
+	    , m_engine(engine)
+	{
+	}
+	BasicRuntime(PagedMemory<Word> memory, Engine engine = Engine::Switch)
+	    : m_memory(std::move(memory))
+	    , m_engine(engine)
+	{
+	}
+	void                run();
+	// Executes the next instruction alone with the switch engine, for hosts
+	// that stop between instructions, and returns the state it leaves.
+	State               step();
+	// Returns an independent machine in the same state whose memory shares
+	// pages copy-on-write with this one. Decoded code is rebuilt lazily by
+	// the fork. Not safe to call concurrently on the same machine.
+	BasicRuntime        fork();
+	void                setEngine(Engine engine);
+	State               state() const;
+	bool                isHalted() const;
+	// Resumes execution elsewhere, e.g. when compiled code hands a machine
+	// over to the interpreter part-way through a run. A halted machine can
+	// run again afterwards.
+	void                setRegisters(Word instructionPointer, Word relativeBase);
+	Word                instructionPointer() const;
+	Word                relativeBase() const;
+	Word                read(Word address) const;
+	// Stores like an instruction would, dropping any code decoded from the
+	// address.
+	void                write(Word address, Word value);
+	// Lets stores skip the checks for self-modifying code. Only for programs
+	// proven never to write their code, see optimizeProgram() in Analyzer.h;
+	// setRegisters() clears it, since the proof assumes a run from address 0.
+	void                setImmutableCode(bool immutable);
+	void                addInput(Word);
+	size_t              pendingInputs() const;
+	std::optional<Word> getOutput();
+	size_t              pendingOutputs() const;
+	// Moves as many pending outputs as fit into the span and returns how many.
+	size_t              drainOutputs(std::span<Word> outputs);
+	// Saves memory, registers, state and both queues to fileName; see
+	// Checkpoint.h. The first checkpoint to a file writes every page, and
+	// later ones to the same file append only the pages written since, so
+	// checkpointing often stays cheap.
+	void                checkpoint(const std::string& fileName);
+	// Resumes a machine saved by checkpoint(). Its pages are used in place
+	// from a copy-on-write mapping of the file, and checkpoints to the same
+	// file carry on appending to it.
+	static BasicRuntime restore(const std::string& fileName, Engine engine = Engine::Switch);
+
+	template <typename Range>
+	void
+	addInputs(const Range& inputs)
+	{
+		m_inputQueue.push(std::begin(inputs), std::end(inputs));
+	}
+
+	// Copies the machine into a wider word type, e.g. after it stopped in
+	// State::Overflowed; the promoted machine resumes at the instruction
+	// that overflowed.
+	template <typename Wider, bool WiderChecked = Checked>
+	BasicRuntime<Wider, WiderChecked, Policy>
+	promote() const
+	{
+		PagedMemory<Wider> memory;
+		m_memory.forEachPage([&](uint64_t first, const auto& page) {
+			for (uint64_t offset = 0; offset < page.size(); ++offset)
+			{
+				if (page[offset] != 0)
+				{
+					memory.write(first + offset, page[offset]);
+				}
+			}
+		});
+		BasicRuntime<Wider, WiderChecked, Policy> promoted(std::move(memory), m_engine);
+		promoted.m_instructionPointer = m_instructionPointer;
+		promoted.m_relativeBase       = m_relativeBase;
+		promoted.m_immutableCode      = m_immutableCode;
+		promoted.m_state = m_state == State::Overflowed ? State::Initialized : m_state;
+		for (size_t i = 0; i < m_inputQueue.size(); ++i)
+		{
+			promoted.m_inputQueue.push(m_inputQueue[i]);
+		}
+		for (size_t i = 0; i < m_outputQueue.size(); ++i)
+		{
+			promoted.m_outputQueue.push(m_outputQueue[i]);
+		}
+		return promoted;
+	}
+
+	// Counters gathered so far; empty unless the policy profiles.
+	const ProfilerType& profiler();
+	// Recent execution history; empty unless the policy traces.
+	const TracerType&   tracer() const;
+
+	friend std::ostream& operator<< <>(std::ostream& stream, const BasicRuntime& runtime);
+
+private:
+	template <typename, bool, typename>
+	friend class BasicRuntime;
+
+	// Returns false when the machine stops running (halt, awaiting input or
+	// overflow).
+	using Handler     = bool (*)(BasicRuntime&, const Instruction&);
+	using TraceRecord = typename TracerType::Record;
+
+	struct CachedInstruction
+	{
+		Instruction m_instruction;
+		Handler     m_handler{};
+		bool        m_valid{};
+		[[no_unique_address]] mutable typename ProfilerType::Counter m_executions;
+	};
+
+	struct BlockOperation;
+	// Blocks hand their handlers the whole operation, so that a fused pair's
+	// handler can read the operation behind it.
+	using BlockHandler = bool (*)(BasicRuntime&, const BlockOperation&);
+
+	struct BlockOperation
+	{
+		Instruction  m_instruction;
+		BlockHandler m_handler{};
+		int          m_next{};
+		// 2 for a fused pair, whose second operation is skipped.
+		uint8_t      m_length{1};
+	};
+
+	struct Block
+	{
+		int                         m_end{};
+		std::vector<BlockOperation> m_operations;
+		uint32_t                    m_visits{};
+		[[no_unique_address]] mutable typename ProfilerType::Counter m_executions;
+	};
+
+	static constexpr int      maxBlockOperations = 64;
+	// Blocks entered this often get their pairs fused. Fusion runs several
+	// instructions per handler, so it is left out when the policy traces or
+	// validates them one at a time.
+	static constexpr uint32_t fuseAfterVisits    = 8;
+	static constexpr bool     fuses              = !TracerType::enabled && !Policy::validate;
+	// Code above this address is decoded on every visit instead of cached.
+	static constexpr Word maxCachedAddress = Word{1} << 20;
+
+	void                     runSwitch();
+	const Instruction&       stepSwitch();
+	void                     unprofileStalled(const Instruction& instruction);
+	void                     runThreaded();
+	void                     runBlocks();
+	Block&                   compiledBlock();
+	void                     fuse(Block& block);
+	bool                     reserveCode(Word address);
+	const CachedInstruction& cachedInstruction();
+	const CachedInstruction& uncachedInstruction();
+	void                     decodeCachedInstruction(CachedInstruction& entry);
+	void                     refreshCachedInstruction(CachedInstruction& entry);
+	const Instruction&       nextInstruction();
+	Instruction              decodeInstruction(Word address) const;
+	void                     executeInstruction(const Instruction& instruction);
+	Word                     getParameter(const BasicParameter<Word>& parameter);
+	void                     setParameter(const BasicParameter<Word>& parameter, Word value);
+	void                     invalidateCode(Word index);
+	bool                     overflow(const Instruction& instruction);
+	void                     profile(const Instruction& instruction, Word instructionPointer,
+	                                 int64_t times, uint64_t relativeBase);
+	void                     restartCounter(const CachedInstruction& entry);
+	void                     restartCounter(const Block& block);
+	void                     flushProfile(const CachedInstruction& entry, Word address);
+	void                     flushProfile(const Block& block);
+	void                     flushProfile();
+	void                     unprofileRest(const Block& block, const BlockOperation& last,
+	                                       bool lastIncomplete);
+	template <typename Code>
+	bool                     dispatch(bool (*handler)(BasicRuntime&, const Code&), const Code& code);
+	void                     validate(const Instruction& instruction) const;
+	TraceRecord              traceBegin(const Instruction& instruction) const;
+	void                     traceEnd(TraceRecord& record);
+
+	// Return false if Checked and the result does not fit in Word.
+	static bool add(Word lhs, Word rhs, Word& result);
+	static bool multiply(Word lhs, Word rhs, Word& result);
+
+	template <ParameterMode Mode>
+	Word load(Word value);
+	template <ParameterMode Mode>
+	void store(Word value, Word result);
+
+	// Only reached through handler tables; kept out of line in
+	// executeOperation() too, since a second copy of every handler costs
+	// the rest of the file its inlining.
+	template <size_t Index>
+	[[gnu::noinline]] static bool execute(BasicRuntime& runtime, const Instruction& instruction);
+	template <size_t... Index>
+	static constexpr std::array<Handler, sizeof...(Index)>
+	               makeHandlerTable(std::index_sequence<Index...>);
+	static size_t  handlerIndex(const Instruction& instruction);
+	static Handler handlerFor(const Instruction& instruction);
+
+	template <size_t Index>
+	static bool         executeOperation(BasicRuntime& runtime, const BlockOperation& operation);
+	static BlockHandler blockHandlerFor(const Instruction& instruction);
+	template <size_t Index>
+	static bool         executeCompareBranch(BasicRuntime& runtime, const BlockOperation& operation);
+	template <size_t Index>
+	static bool         executeAddChain(BasicRuntime& runtime, const BlockOperation& operation);
+	static BlockHandler fusedHandlerFor(const Instruction& first, Instruction& second);
+
+	PagedMemory<Word>                   m_memory;
+	Engine                              m_engine{Engine::Switch};
+	std::vector<CachedInstruction>      m_instructionCache;
+	std::vector<std::unique_ptr<Block>> m_blockCache;
+	std::vector<std::unique_ptr<Block>> m_retiredBlocks;
+	CachedInstruction                   m_uncachedInstruction;
+	bool                                m_blockInvalidated{};
+	bool                                m_immutableCode{};
+	// Non-zero for every word that a cached instruction or block was built
+	// from, so stores only pay for invalidation when they hit code.
+	std::vector<uint8_t>                m_isCode;
+	Word                                m_instructionPointer{};
+	Word                                m_relativeBase{};
+	State                               m_state{State::Initialized};
+	RingBuffer<Word>                    m_inputQueue;
+	RingBuffer<Word>                    m_outputQueue;
+	// Where the last checkpoint went; a fork starts without one.
+	std::string                         m_checkpointFile;
+	[[no_unique_address]] ProfilerType m_profiler;
+	[[no_unique_address]] TracerType   m_tracer;
+};
+
+using Runtime        = BasicRuntime<ProgramValue>;
+using Runtime32      = BasicRuntime<int32_t>;
+using TrustedRuntime = BasicRuntime<ProgramValue, false, TrustedPolicy>;
+using DebugRuntime   = BasicRuntime<ProgramValue, false, DebugPolicy>;
+
+// Instantiated in Intcode.cpp.
+extern template class BasicRuntime<int32_t>;
+extern template class BasicRuntime<int32_t, true>;
+extern template class BasicRuntime<ProgramValue>;
+extern template class BasicRuntime<ProgramValue, true>;
+extern template class BasicRuntime<WideValue, true>;
+extern template class BasicRuntime<ProgramValue, false, TrustedPolicy>;
+extern template class BasicRuntime<ProgramValue, false, DebugPolicy>;
+
+// Parses comma-separated values, allowing whitespace around them. Throws
+// std::runtime_error naming the line and column of a malformed value.
+Program parseProgram(std::string_view text, const std::string& name = "<program>");
+// Maps the file and parses it in place; throws if it cannot be read.
+Program loadProgram(const std::string& fileName);
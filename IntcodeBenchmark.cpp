@@ -0,0 +1,685 @@
+#include "BatchRuntime.h"
+#include "CompiledRuntime.h"
+#include "Intcode.h"
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times the bundled puzzle programs under every engine. Run it from input/.
+// Each workload first runs once on a plain reference interpreter, which
+// counts the instructions it executes and records the outputs that every
+// engine must reproduce; then each engine gets one warm-up run and a number
+// of timed trials. Allocations and peak heap use are measured per run by
+// replacing the global operator new and delete.
+//
+// Single-machine workloads are also run --lanes times over, on as many
+// independent Runtimes and on one BatchRuntime with a lane each. Every lane
+// gets the same inputs, so the batch never splits: this is its best case,
+// the throughput a sweep whose lanes keep in step can approach.
+//
+// --save-baseline writes the median ns/instruction of every workload and
+// engine; --baseline compares against such a file and fails the run when
+// one is slower by more than --threshold percent.
+
+namespace
+{
+std::atomic<uint64_t> allocations{0};
+std::atomic<int64_t>  liveBytes{0};
+std::atomic<int64_t>  peakBytes{0};
+
+void*
+track(void* pointer)
+{
+	if (!pointer)
+	{
+		throw std::bad_alloc();
+	}
+	++allocations;
+	int64_t live = liveBytes += malloc_usable_size(pointer);
+	int64_t peak = peakBytes;
+	while (live > peak && !peakBytes.compare_exchange_weak(peak, live))
+	{
+	}
+	return pointer;
+}
+
+void
+untrack(void* pointer)
+{
+	if (pointer)
+	{
+		liveBytes -= malloc_usable_size(pointer);
+		std::free(pointer);
+	}
+}
+} // namespace
+
+void*
+operator new(size_t size)
+{
+	return track(std::malloc(size ? size : 1));
+}
+
+void*
+operator new(size_t size, std::align_val_t alignment)
+{
+	size_t align = static_cast<size_t>(alignment);
+	size = (std::max<size_t>(size, 1) + align - 1) / align * align;
+	return track(std::aligned_alloc(align, size));
+}
+
+void
+operator delete(void* pointer) noexcept
+{
+	untrack(pointer);
+}
+
+void
+operator delete(void* pointer, size_t) noexcept
+{
+	untrack(pointer);
+}
+
+void
+operator delete(void* pointer, std::align_val_t) noexcept
+{
+	untrack(pointer);
+}
+
+void
+operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+	untrack(pointer);
+}
+
+namespace
+{
+using Outputs = std::vector<ProgramValue>;
+using Clock   = std::chrono::steady_clock;
+
+// The program IntcodeCompiler translated into this executable; see
+// CMakelists.txt.
+const std::string compiledProgram = "Day9.input.txt";
+
+// A plain decode-and-execute loop without any of Runtime's caching, with
+// the same host interface. Adds every instruction it executes to executed.
+class CountingRuntime
+{
+public:
+	using State = Runtime::State;
+
+	CountingRuntime(const Program& program, uint64_t& executed)
+	    : m_memory(program)
+	    , m_executed(&executed)
+	{
+	}
+
+	void run();
+
+	bool
+	isHalted() const
+	{
+		return m_state == State::Halted;
+	}
+
+	void
+	addInput(ProgramValue value)
+	{
+		m_inputs.push_back(value);
+	}
+
+	template <typename Range>
+	void
+	addInputs(const Range& inputs)
+	{
+		m_inputs.insert(m_inputs.end(), std::begin(inputs), std::end(inputs));
+	}
+
+	std::optional<ProgramValue>
+	getOutput()
+	{
+		if (m_outputs.empty())
+		{
+			return {};
+		}
+		ProgramValue value = m_outputs.front();
+		m_outputs.pop_front();
+		return value;
+	}
+
+private:
+	Memory                   m_memory;
+	ProgramValue             m_instructionPointer{};
+	ProgramValue             m_relativeBase{};
+	State                    m_state{State::Initialized};
+	std::deque<ProgramValue> m_inputs;
+	std::deque<ProgramValue> m_outputs;
+	uint64_t*                m_executed;
+};
+
+void
+CountingRuntime::run()
+{
+	m_state = State::Running;
+	while (m_state == State::Running)
+	{
+		Instruction  instruction = decodeInstruction(m_memory, m_instructionPointer);
+		const auto&  params      = instruction.m_parameters;
+		ProgramValue next        = m_instructionPointer + 1 + instruction.m_numParameters;
+
+		auto address = [&](int i) {
+			return params[i].m_mode == ParameterMode::RelativePosition
+			           ? params[i].m_value + m_relativeBase
+			           : params[i].m_value;
+		};
+		auto value = [&](int i) {
+			return params[i].m_mode == ParameterMode::Value ? params[i].m_value
+			                                                : m_memory.read(address(i));
+		};
+		// Wrapping arithmetic, as in an unchecked Runtime.
+		auto wrap = [](uint64_t result) { return static_cast<ProgramValue>(result); };
+
+		switch (instruction.m_opCode)
+		{
+		case OpCode::Add:
+			m_memory.write(address(2), wrap(uint64_t(value(0)) + uint64_t(value(1))));
+			break;
+		case OpCode::Mult:
+			m_memory.write(address(2), wrap(uint64_t(value(0)) * uint64_t(value(1))));
+			break;
+		case OpCode::Input:
+			if (m_inputs.empty())
+			{
+				m_state = State::AwaitingInput;
+				return;
+			}
+			m_memory.write(address(0), m_inputs.front());
+			m_inputs.pop_front();
+			break;
+		case OpCode::Output:
+			m_outputs.push_back(value(0));
+			break;
+		case OpCode::JumpTrue:
+			next = value(0) != 0 ? value(1) : next;
+			break;
+		case OpCode::JumpFalse:
+			next = value(0) == 0 ? value(1) : next;
+			break;
+		case OpCode::LessThan:
+			m_memory.write(address(2), value(0) < value(1) ? 1 : 0);
+			break;
+		case OpCode::Equals:
+			m_memory.write(address(2), value(0) == value(1) ? 1 : 0);
+			break;
+		case OpCode::NudgeRelativeBase:
+			m_relativeBase = wrap(uint64_t(m_relativeBase) + uint64_t(value(0)));
+			break;
+		case OpCode::Halt:
+			m_state = State::Halted;
+			break;
+		default:
+			throw std::runtime_error("unknown opcode at " + std::to_string(m_instructionPointer));
+		}
+		++*m_executed;
+		m_instructionPointer = next;
+	}
+}
+
+enum class Kind
+{
+	// Feeds the inputs to one machine and collects every output.
+	Single,
+	// Day 7 part 2: the best signal over every phase order of a loop of
+	// five amplifiers.
+	FeedbackLoop
+};
+
+struct Workload
+{
+	std::string               m_name;
+	std::string               m_file;
+	Kind                      m_kind{};
+	std::vector<ProgramValue> m_inputs;
+};
+
+const std::vector<Workload> workloads = {
+    {"day5-part1", "Day5.input.txt", Kind::Single, {1}},
+    {"day5-part2", "Day5.input.txt", Kind::Single, {5}},
+    {"day7-feedback", "Day7.input.txt", Kind::FeedbackLoop, {}},
+    {"day9-part1", "Day9.input.txt", Kind::Single, {1}},
+    {"day9-part2", "Day9.input.txt", Kind::Single, {2}},
+    {"day9-quine", "Day9.input.test1.txt", Kind::Single, {}},
+    {"day9-test2", "Day9.input.test2.txt", Kind::Single, {}},
+    {"day9-test3", "Day9.input.test3.txt", Kind::Single, {}},
+};
+
+template <typename Machine>
+void
+drain(Machine& machine, Outputs& outputs)
+{
+	while (auto output = machine.getOutput())
+	{
+		outputs.push_back(*output);
+	}
+}
+
+// Runs a workload on machines created by make(); returns its outputs.
+template <typename Make>
+Outputs
+runWorkload(const Workload& workload, Make make)
+{
+	Outputs outputs;
+	if (workload.m_kind == Kind::Single)
+	{
+		auto machine = make();
+		machine.addInputs(workload.m_inputs);
+		machine.run();
+		drain(machine, outputs);
+		return outputs;
+	}
+
+	std::vector<ProgramValue> phases = {5, 6, 7, 8, 9};
+	ProgramValue              best   = std::numeric_limits<ProgramValue>::min();
+	do
+	{
+		std::vector<decltype(make())> amplifiers;
+		for (ProgramValue phase : phases)
+		{
+			amplifiers.push_back(make());
+			amplifiers.back().addInput(phase);
+		}
+		ProgramValue signal = 0;
+		while (!amplifiers.back().isHalted())
+		{
+			for (auto& amplifier : amplifiers)
+			{
+				amplifier.addInput(signal);
+				amplifier.run();
+				signal = amplifier.getOutput().value_or(signal);
+			}
+		}
+		best = std::max(best, signal);
+	} while (std::next_permutation(phases.begin(), phases.end()));
+	outputs.push_back(best);
+	return outputs;
+}
+
+// Runs a single-machine workload once per lane on Runtimes of the given
+// engine; returns every lane's outputs in turn.
+Outputs
+runRuntimes(const Workload& workload, const Program& program, size_t lanes,
+            Runtime::Engine engine)
+{
+	std::vector<Runtime> runtimes;
+	runtimes.reserve(lanes);
+	for (size_t lane = 0; lane < lanes; ++lane)
+	{
+		runtimes.emplace_back(program, engine);
+		runtimes.back().addInputs(workload.m_inputs);
+	}
+	Outputs outputs;
+	for (auto& runtime : runtimes)
+	{
+		runtime.run();
+		drain(runtime, outputs);
+	}
+	return outputs;
+}
+
+Outputs
+runBatch(const Workload& workload, const Program& program, size_t lanes)
+{
+	BatchRuntime batch(program, lanes);
+	for (size_t lane = 0; lane < lanes; ++lane)
+	{
+		for (ProgramValue input : workload.m_inputs)
+		{
+			batch.addInput(lane, input);
+		}
+	}
+	batch.run();
+	Outputs outputs;
+	for (size_t lane = 0; lane < lanes; ++lane)
+	{
+		while (auto output = batch.getOutput(lane))
+		{
+			outputs.push_back(*output);
+		}
+	}
+	return outputs;
+}
+
+struct Options
+{
+	int         m_trials{10};
+	size_t      m_lanes{64};
+	double      m_threshold{10};
+	std::string m_baseline;
+	std::string m_saveBaseline;
+	std::string m_filter;
+};
+
+struct Summary
+{
+	double m_min{};
+	double m_median{};
+	double m_mean{};
+	double m_stddev{};
+};
+
+Summary
+summarize(std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	Summary summary;
+	size_t  count    = samples.size();
+	summary.m_min    = samples.front();
+	summary.m_median = count % 2 ? samples[count / 2]
+	                             : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+	for (double sample : samples)
+	{
+		summary.m_mean += sample / count;
+	}
+	for (double sample : samples)
+	{
+		summary.m_stddev += (sample - summary.m_mean) * (sample - summary.m_mean);
+	}
+	summary.m_stddev = count > 1 ? std::sqrt(summary.m_stddev / (count - 1)) : 0;
+	return summary;
+}
+
+struct Result
+{
+	std::string m_workload;
+	std::string m_engine;
+	uint64_t    m_instructions{};
+	Summary     m_nanoseconds;
+	uint64_t    m_allocations{};
+	int64_t     m_peakBytes{};
+};
+
+// Times trials calls of run() after a warm-up call whose outputs are checked
+// against the reference. Returns false on a mismatch.
+template <typename Run>
+bool
+measure(const Outputs& expected, int trials, Run run, Result& result)
+{
+	if (run() != expected)
+	{
+		return false;
+	}
+	std::vector<double> nanoseconds;
+	for (int trial = 0; trial < trials; ++trial)
+	{
+		uint64_t allocationsBefore = allocations;
+		int64_t  liveBefore        = liveBytes;
+		peakBytes                  = liveBefore;
+
+		Clock::time_point start   = Clock::now();
+		Outputs           outputs = run();
+		Clock::time_point end     = Clock::now();
+
+		nanoseconds.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+		result.m_allocations = allocations - allocationsBefore;
+		result.m_peakBytes   = std::max<int64_t>(result.m_peakBytes, peakBytes - liveBefore);
+	}
+	result.m_nanoseconds = summarize(nanoseconds);
+	return true;
+}
+
+double
+nanosecondsPerInstruction(const Result& result)
+{
+	return result.m_nanoseconds.m_median / result.m_instructions;
+}
+
+std::map<std::string, double>
+loadBaseline(const std::string& path)
+{
+	std::map<std::string, double> baseline;
+	std::ifstream                 file(path);
+	if (!file)
+	{
+		throw std::runtime_error(path + ": cannot open baseline");
+	}
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		std::string        workload, engine;
+		double             value;
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		if (!(fields >> workload >> engine >> value))
+		{
+			throw std::runtime_error(path + ": malformed line '" + line + "'");
+		}
+		baseline[workload + " " + engine] = value;
+	}
+	return baseline;
+}
+
+void
+saveBaseline(const std::string& path, const std::vector<Result>& results)
+{
+	std::ofstream file(path);
+	file << "# workload engine ns/instruction (median)\n";
+	for (const auto& result : results)
+	{
+		file << result.m_workload << ' ' << result.m_engine << ' '
+		     << nanosecondsPerInstruction(result) << '\n';
+	}
+}
+
+bool
+parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (i + 1 == argc)
+		{
+			return false;
+		}
+		std::string value = argv[++i];
+		if (option == "--trials")
+		{
+			options.m_trials = std::max(1, std::atoi(value.c_str()));
+		}
+		else if (option == "--lanes")
+		{
+			options.m_lanes = std::max(1, std::atoi(value.c_str()));
+		}
+		else if (option == "--threshold")
+		{
+			options.m_threshold = std::atof(value.c_str());
+		}
+		else if (option == "--baseline")
+		{
+			options.m_baseline = value;
+		}
+		else if (option == "--save-baseline")
+		{
+			options.m_saveBaseline = value;
+		}
+		else if (option == "--filter")
+		{
+			options.m_filter = value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0]
+		          << " [--trials N] [--lanes N] [--filter text] [--baseline file]"
+		             " [--save-baseline file] [--threshold percent]"
+		          << std::endl;
+		return 1;
+	}
+
+	const std::pair<const char*, Runtime::Engine> engines[] = {
+	    {"switch", Runtime::Engine::Switch},
+	    {"threaded", Runtime::Engine::Threaded},
+	    {"block", Runtime::Engine::Block},
+	};
+
+	std::cout << std::left << std::setw(15) << "workload" << std::setw(10) << "engine"
+	          << std::right << std::setw(10) << "instrs" << std::setw(12) << "median us"
+	          << std::setw(9) << "+-%" << std::setw(10) << "ns/instr" << std::setw(11)
+	          << "Minstr/s" << std::setw(8) << "allocs" << std::setw(10) << "peak KiB"
+	          << std::endl;
+
+	std::vector<Result> results;
+	bool                failed = false;
+	for (const auto& workload : workloads)
+	{
+		if (workload.m_name.find(options.m_filter) == std::string::npos)
+		{
+			continue;
+		}
+		Program  program      = loadProgram(workload.m_file);
+		uint64_t instructions = 0;
+		Outputs  expected     = runWorkload(
+		    workload, [&] { return CountingRuntime(program, instructions); });
+
+		// Counts every lane's instructions, so that ns/instr compares
+		// throughput across rows.
+		auto report = [&](Result result, size_t lanes = 1) {
+			result.m_workload     = workload.m_name;
+			result.m_instructions = instructions * lanes;
+			std::cout << std::left << std::setw(15) << result.m_workload << std::setw(10)
+			          << result.m_engine << std::right << std::setw(10)
+			          << result.m_instructions << std::fixed << std::setprecision(1)
+			          << std::setw(12) << result.m_nanoseconds.m_median / 1000 << std::setw(9)
+			          << 100 * result.m_nanoseconds.m_stddev / result.m_nanoseconds.m_mean
+			          << std::setprecision(2) << std::setw(10)
+			          << nanosecondsPerInstruction(result) << std::setw(11)
+			          << 1000 / nanosecondsPerInstruction(result) << std::setw(8)
+			          << result.m_allocations << std::setprecision(1) << std::setw(10)
+			          << result.m_peakBytes / 1024.0 << std::endl;
+			results.push_back(result);
+		};
+		auto mismatch = [&](const char* engine) {
+			std::cerr << workload.m_name << ": " << engine
+			          << " outputs differ from the reference" << std::endl;
+			failed = true;
+		};
+
+		for (const auto& [name, engine] : engines)
+		{
+			Result result;
+			result.m_engine = name;
+			if (!measure(expected, options.m_trials, [&, engine = engine] {
+				    return runWorkload(workload, [&] { return Runtime(program, engine); });
+			    }, result))
+			{
+				mismatch(name);
+				continue;
+			}
+			report(result);
+		}
+		if (workload.m_file == compiledProgram)
+		{
+			Result result;
+			result.m_engine = "compiled";
+			if (!measure(expected, options.m_trials,
+			             [&] { return runWorkload(workload, [] { return CompiledRuntime(); }); },
+			             result))
+			{
+				mismatch("compiled");
+				continue;
+			}
+			report(result);
+		}
+		if (workload.m_kind == Kind::Single)
+		{
+			size_t  lanes = options.m_lanes;
+			Outputs everyLane;
+			for (size_t lane = 0; lane < lanes; ++lane)
+			{
+				everyLane.insert(everyLane.end(), expected.begin(), expected.end());
+			}
+			Result runtimes;
+			runtimes.m_engine = "runtimes";
+			if (measure(everyLane, options.m_trials, [&] {
+				    return runRuntimes(workload, program, lanes, Runtime::Engine::Block);
+			    }, runtimes))
+			{
+				report(runtimes, lanes);
+			}
+			else
+			{
+				mismatch("runtimes");
+			}
+			Result batch;
+			batch.m_engine = "batch";
+			if (measure(everyLane, options.m_trials,
+			            [&] { return runBatch(workload, program, lanes); }, batch))
+			{
+				report(batch, lanes);
+			}
+			else
+			{
+				mismatch("batch");
+			}
+		}
+	}
+
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	std::cout << "max resident set " << usage.ru_maxrss << " KiB" << std::endl;
+
+	if (!options.m_saveBaseline.empty())
+	{
+		saveBaseline(options.m_saveBaseline, results);
+	}
+	if (!options.m_baseline.empty())
+	{
+		auto baseline = loadBaseline(options.m_baseline);
+		for (const auto& result : results)
+		{
+			auto it = baseline.find(result.m_workload + " " + result.m_engine);
+			if (it == baseline.end())
+			{
+				continue;
+			}
+			double change = 100 * (nanosecondsPerInstruction(result) / it->second - 1);
+			if (change > options.m_threshold)
+			{
+				std::cerr << "regression: " << result.m_workload << " " << result.m_engine
+				          << " " << std::fixed << std::setprecision(1) << change
+				          << "% slower than baseline" << std::endl;
+				failed = true;
+			}
+		}
+	}
+	return failed ? 1 : 0;
+}
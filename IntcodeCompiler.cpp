@@ -0,0 +1,325 @@
+#include "Intcode.h"
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Translates an Intcode program into a C++ translation unit implementing
+// CompiledRuntime (see CompiledRuntime.h). Every instruction reachable from
+// address 0 through fall-through and immediate jump targets gets its own
+// label; operands are resolved to direct memory accesses or literals, so no
+// decoding or dispatch happens at run time. Indirect jumps and resumption
+// after input go through a switch over the labels, and anything the
+// translation could not see (self-modification, unreachable targets, unknown
+// opcodes) hands the machine over to the interpreter.
+
+namespace
+{
+using Reachable = std::map<ProgramValue, Instruction>;
+
+bool
+fitsInImage(const Program& program, ProgramValue address)
+{
+	auto size = static_cast<ProgramValue>(program.size());
+	if (address < 0 || address >= size)
+	{
+		return false;
+	}
+	auto opCode = static_cast<OpCode>(program[address] % 100);
+	return address + numParams(opCode) < size;
+}
+
+Reachable
+findReachable(const Program& program)
+{
+	Reachable                 reachable;
+	std::vector<ProgramValue> pending{0};
+	while (!pending.empty())
+	{
+		ProgramValue address = pending.back();
+		pending.pop_back();
+		if (reachable.count(address) || !fitsInImage(program, address))
+		{
+			continue;
+		}
+		Instruction instruction = decodeInstruction(program, address);
+		reachable[address]      = instruction;
+		if (!isKnownOpCode(instruction.m_opCode) ||
+		    instruction.m_opCode == OpCode::Halt)
+		{
+			continue;
+		}
+		pending.push_back(address + 1 + instruction.m_numParameters);
+		if ((instruction.m_opCode == OpCode::JumpTrue ||
+		     instruction.m_opCode == OpCode::JumpFalse) &&
+		    instruction.m_parameters[1].m_mode == ParameterMode::Value)
+		{
+			pending.push_back(instruction.m_parameters[1].m_value);
+		}
+	}
+	return reachable;
+}
+
+std::set<ProgramValue>
+findCode(const Reachable& reachable)
+{
+	std::set<ProgramValue> code;
+	for (const auto& [address, instruction] : reachable)
+	{
+		for (int i = 0; i <= instruction.m_numParameters; ++i)
+		{
+			code.insert(address + i);
+		}
+	}
+	return code;
+}
+
+std::string
+literal(ProgramValue value)
+{
+	// The most negative value has no literal: its magnitude does not fit.
+	if (value == std::numeric_limits<ProgramValue>::min())
+	{
+		return "(" + std::to_string(value + 1) + "LL - 1)";
+	}
+	return "(" + std::to_string(value) + "LL)";
+}
+
+class Emitter
+{
+public:
+	Emitter(const Program& program, std::ostream& out)
+	    : m_program(program)
+	    , m_reachable(findReachable(program))
+	    , m_code(findCode(m_reachable))
+	    , m_out(out)
+	{
+	}
+
+	void emit(const std::string& source);
+
+private:
+	std::string read(const Parameter& parameter) const;
+	bool        write(ProgramValue address, const Parameter& parameter,
+	                  const std::string& value);
+	void        jump(const Parameter& target);
+	void        leave(ProgramValue address, const std::string& how);
+	void        emitInstruction(ProgramValue address, const Instruction& instruction);
+
+	const Program&         m_program;
+	Reachable              m_reachable;
+	std::set<ProgramValue> m_code;
+	std::ostream&          m_out;
+};
+
+std::string
+Emitter::read(const Parameter& parameter) const
+{
+	switch (parameter.m_mode)
+	{
+	case ParameterMode::Value:
+		return literal(parameter.m_value);
+	case ParameterMode::RelativePosition:
+		return "m_memory.read(rb + " + literal(parameter.m_value) + ")";
+	default:
+		return "m_memory.read(" + literal(parameter.m_value) + ")";
+	}
+}
+
+// Returns true when the write always leaves compiled code because it lands
+// on an instruction word.
+bool
+Emitter::write(ProgramValue address, const Parameter& parameter,
+               const std::string& value)
+{
+	ProgramValue next = address + 1 + m_reachable.at(address).m_numParameters;
+	if (parameter.m_mode == ParameterMode::RelativePosition)
+	{
+		m_out << "\tif (store(rb + " << literal(parameter.m_value) << ", "
+		      << value << "))\n\t{\n";
+		leave(next, "fallBack");
+		m_out << "\t}\n";
+		return false;
+	}
+	m_out << "\tm_memory.write(" << literal(parameter.m_value) << ", " << value
+	      << ");\n";
+	if (m_code.count(parameter.m_value))
+	{
+		leave(next, "fallBack");
+		return true;
+	}
+	return false;
+}
+
+void
+Emitter::jump(const Parameter& target)
+{
+	if (target.m_mode == ParameterMode::Value &&
+	    m_reachable.count(target.m_value))
+	{
+		m_out << "\t\tgoto ip" << target.m_value << ";\n";
+		return;
+	}
+	m_out << "\t\tm_instructionPointer = " << read(target) << ";\n";
+	m_out << "\t\tgoto dispatch;\n";
+}
+
+// Saves the registers held in locals and leaves run(), either suspending
+// with the given state or handing over to the interpreter.
+void
+Emitter::leave(ProgramValue address, const std::string& how)
+{
+	m_out << "\tm_relativeBase = rb;\n";
+	if (how == "fallBack")
+	{
+		m_out << "\tfallBack(" << address << ");\n";
+	}
+	else
+	{
+		m_out << "\tm_instructionPointer = " << address << ";\n";
+		m_out << "\tm_state = State::" << how << ";\n";
+	}
+	m_out << "\treturn;\n";
+}
+
+void
+Emitter::emitInstruction(ProgramValue address, const Instruction& instruction)
+{
+	const auto& p    = instruction.m_parameters;
+	bool        left = false;
+	m_out << "ip" << address << ": // " << instruction << "\n";
+	switch (instruction.m_opCode)
+	{
+	case OpCode::Add:
+		left = write(address, p[2], read(p[0]) + " + " + read(p[1]));
+		break;
+	case OpCode::Mult:
+		left = write(address, p[2], read(p[0]) + " * " + read(p[1]));
+		break;
+	case OpCode::Input:
+		m_out << "\tif (m_inputQueue.empty())\n\t{\n";
+		leave(address, "AwaitingInput");
+		m_out << "\t}\n";
+		m_out << "\tinput = m_inputQueue.pop();\n";
+		left = write(address, p[0], "input");
+		break;
+	case OpCode::Output:
+		m_out << "\tm_outputQueue.push(" << read(p[0]) << ");\n";
+		break;
+	case OpCode::JumpTrue:
+		m_out << "\tif (" << read(p[0]) << " != 0)\n\t{\n";
+		jump(p[1]);
+		m_out << "\t}\n";
+		break;
+	case OpCode::JumpFalse:
+		m_out << "\tif (" << read(p[0]) << " == 0)\n\t{\n";
+		jump(p[1]);
+		m_out << "\t}\n";
+		break;
+	case OpCode::LessThan:
+		left = write(address, p[2],
+		             "(" + read(p[0]) + " < " + read(p[1]) + ") ? 1 : 0");
+		break;
+	case OpCode::Equals:
+		left = write(address, p[2],
+		             "(" + read(p[0]) + " == " + read(p[1]) + ") ? 1 : 0");
+		break;
+	case OpCode::NudgeRelativeBase:
+		m_out << "\trb += " << read(p[0]) << ";\n";
+		break;
+	case OpCode::Halt:
+		leave(address, "Halted");
+		return;
+	default:
+		leave(address, "fallBack");
+		return;
+	}
+
+	if (left)
+	{
+		return;
+	}
+	ProgramValue next      = address + 1 + instruction.m_numParameters;
+	auto         following = m_reachable.upper_bound(address);
+	if (following == m_reachable.end() || following->first != next)
+	{
+		if (m_reachable.count(next))
+		{
+			m_out << "\tgoto ip" << next << ";\n";
+		}
+		else
+		{
+			leave(next, "fallBack");
+		}
+	}
+}
+
+void
+Emitter::emit(const std::string& source)
+{
+	m_out << "// Generated by IntcodeCompiler from " << source
+	      << ". Do not edit.\n";
+	m_out << "#include \"CompiledRuntime.h\"\n\n";
+	m_out << "namespace\n{\n";
+	m_out << "const ProgramValue image[] = {";
+	for (size_t i = 0; i < m_program.size(); ++i)
+	{
+		m_out << (i % 8 == 0 ? "\n\t" : " ") << literal(m_program[i]) << ",";
+	}
+	m_out << "\n};\n\n";
+	m_out << "const bool code[] = {";
+	for (size_t i = 0; i < m_program.size(); ++i)
+	{
+		m_out << (i % 16 == 0 ? "\n\t" : " ") << m_code.count(i) << ",";
+	}
+	m_out << "\n};\n} // namespace\n\n";
+
+	m_out << "CompiledRuntime::CompiledRuntime()\n";
+	m_out << "    : m_memory(Program(std::begin(image), std::end(image)))\n{\n}\n\n";
+
+	m_out << "bool\nCompiledRuntime::store(ProgramValue index, ProgramValue value)\n{\n";
+	m_out << "\tm_memory.write(index, value);\n";
+	m_out << "\treturn index >= 0 && "
+	         "index < static_cast<ProgramValue>(std::size(code)) && "
+	         "code[index];\n}\n\n";
+
+	m_out << "void\nCompiledRuntime::run()\n{\n";
+	m_out << "\tif (m_interpreter)\n\t{\n\t\tm_interpreter->run();\n\t\treturn;\n\t}\n";
+	m_out << "\tm_state         = State::Running;\n";
+	m_out << "\tProgramValue rb = m_relativeBase;\n";
+	m_out << "\tProgramValue input{};\n";
+	m_out << "dispatch:\n";
+	m_out << "\tswitch (m_instructionPointer)\n\t{\n";
+	for (const auto& entry : m_reachable)
+	{
+		m_out << "\tcase " << entry.first << ": goto ip" << entry.first << ";\n";
+	}
+	m_out << "\tdefault:\n\t\tm_relativeBase = rb;\n"
+	         "\t\tfallBack(m_instructionPointer);\n\t\treturn;\n\t}\n";
+	for (const auto& [address, instruction] : m_reachable)
+	{
+		emitInstruction(address, instruction);
+	}
+	m_out << "}\n";
+}
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "usage: " << argv[0] << " <program.txt> <output.cpp>"
+		          << std::endl;
+		return 1;
+	}
+	Program       program = loadProgram(argv[1]);
+	std::ofstream out(argv[2]);
+	Emitter(program, out).emit(argv[1]);
+	return out ? 0 : 1;
+}
@@ -0,0 +1,612 @@
+#include "Analyzer.h"
+#include "BatchRuntime.h"
+#include "CompiledRuntime.h"
+#include "Intcode.h"
+#include "Io.h"
+#include "Network.h"
+#include "Pipeline.h"
+#include "TimeTravel.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Checks for behaviour the Day programs don't exercise. Runs from input/,
+// where the programs live; exits non-zero if any check fails.
+namespace
+{
+int failures = 0;
+
+void
+expect(bool condition, const std::string& what)
+{
+	if (!condition)
+	{
+		std::cerr << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+// A block starting just below the end of the block cache writes into the
+// instruction that follows it, past the end; the write must be seen.
+void
+blockAtCacheLimit()
+{
+	constexpr ProgramValue start = (1 << 20) - 4;
+
+	Program program(start + 7);
+	// Jump to start.
+	program[0] = 1105;
+	program[1] = 1;
+	program[2] = start;
+	// Store 7 as the parameter of the output that follows, then output it.
+	program[start + 0] = 1101;
+	program[start + 1] = 0;
+	program[start + 2] = 7;
+	program[start + 3] = start + 5;
+	program[start + 4] = 104;
+	program[start + 5] = 0;
+	program[start + 6] = 99;
+
+	for (auto engine : {Runtime::Engine::Switch, Runtime::Engine::Threaded, Runtime::Engine::Block})
+	{
+		Runtime runtime(program, engine);
+		runtime.run();
+		auto output = runtime.getOutput();
+		expect(output && *output == 7,
+		       "write past the block cache limit, engine " + std::to_string(int(engine)));
+	}
+}
+
+// IntcodeTest.input.txt, compiled into this test, stores a halt above 2^32
+// and jumps to it with an immediate target; the 7 after the jump is never
+// output. A target truncated to 32 bits would land on that output instead.
+void
+compiledFarJump()
+{
+	Runtime interpreted(loadProgram("IntcodeTest.input.txt"));
+	interpreted.run();
+	expect(interpreted.isHalted() && !interpreted.getOutput(),
+	       "interpreted jump above 2^32");
+
+	CompiledRuntime compiled;
+	compiled.run();
+	expect(compiled.isHalted() && !compiled.getOutput(), "compiled jump above 2^32");
+}
+
+// An empty read leaves the callback's next value for the following read.
+void
+callbackSourceEmptyRead()
+{
+	ProgramValue next   = 1;
+	auto         source = io::callbackSource<ProgramValue>([&]() -> std::optional<ProgramValue> {
+		return next++;
+	});
+
+	ProgramValue value{};
+	expect(source.read(std::span<ProgramValue>()) == 0, "empty callback read returns 0");
+	expect(source.read(std::span<ProgramValue>(&value, 1)) == 1 && value == 1,
+	       "empty callback read consumes nothing");
+}
+
+// Lanes store and load far above the program and below address 0, as a
+// Runtime does; with validation both trap on such addresses with the same
+// error.
+void
+batchAddresses()
+{
+	constexpr ProgramValue far = ProgramValue{1} << 40;
+	// in [50]; [-5] = [50] + 1; [far] = [-5] + 1; out [-5]; out [far]; halt
+	Program program{3, 50, 1001, 50, 1, -5, 1001, -5, 1, far, 4, -5, 4, far, 99};
+
+	BatchRuntime batch(program, 3);
+	for (size_t lane = 0; lane < batch.lanes(); ++lane)
+	{
+		batch.addInput(lane, ProgramValue(lane) * 10);
+	}
+	if constexpr (DefaultPolicy::validate)
+	{
+		Runtime runtime(program);
+		runtime.addInput(0);
+		auto error = [](auto& machine) {
+			try
+			{
+				machine.run();
+			}
+			catch (const std::runtime_error& e)
+			{
+				return std::string(e.what());
+			}
+			return std::string();
+		};
+		std::string expected = error(runtime);
+		expect(!expected.empty() && error(batch) == expected,
+		       "batch traps with the error Runtime raises");
+		return;
+	}
+
+	batch.run();
+	for (size_t lane = 0; lane < batch.lanes(); ++lane)
+	{
+		Runtime runtime(program);
+		runtime.addInput(ProgramValue(lane) * 10);
+		runtime.run();
+		for (int i = 0; i < 2; ++i)
+		{
+			auto expected = runtime.getOutput();
+			auto output   = batch.getOutput(lane);
+			expect(expected && output == expected, "batch lane stores where Runtime does");
+		}
+		expect(batch.read(lane, far) == runtime.read(far) && batch.read(lane, -5) == runtime.read(-5),
+		       "batch lane reads back far and negative addresses");
+	}
+}
+
+// Runs the program on the inputs until it halts or wants more, and returns
+// what it printed.
+std::vector<ProgramValue>
+outputsOf(const Program& program, bool immutableCode, Runtime::Engine engine,
+          const std::vector<ProgramValue>& inputs)
+{
+	Runtime runtime(program, engine);
+	runtime.setImmutableCode(immutableCode);
+	runtime.addInputs(inputs);
+	runtime.run();
+	std::vector<ProgramValue> outputs;
+	while (auto output = runtime.getOutput())
+	{
+		outputs.push_back(*output);
+	}
+	return outputs;
+}
+
+// The optimized image, run with the immutable code flag it comes with,
+// prints what the original does under every engine.
+void
+expectOptimizedMatches(const std::string& name, const Program& program,
+                       const std::vector<std::vector<ProgramValue>>& inputs)
+{
+	OptimizedProgram optimized = optimizeProgram(program, analyzeProgram(program));
+	for (auto engine : {Runtime::Engine::Switch, Runtime::Engine::Threaded, Runtime::Engine::Block})
+	{
+		for (const auto& input : inputs)
+		{
+			expect(outputsOf(optimized.m_program, optimized.m_immutableCode, engine, input) ==
+			           outputsOf(program, false, engine, input),
+			       "optimized " + name + " prints what the original does, engine " +
+			           std::to_string(int(engine)));
+		}
+	}
+}
+
+// Day5 and Day7 write into their own code and Day9 returns through
+// addresses on its stack, so the analysis cannot complete and they must
+// come through unchanged. The small program gives every rewrite something
+// to do.
+void
+optimizedPrograms()
+{
+	expectOptimizedMatches("Day5", loadProgram("Day5.input.txt"), {{1}, {5}, {8}});
+	std::vector<std::vector<ProgramValue>> phases;
+	for (ProgramValue phase = 0; phase < 10; ++phase)
+	{
+		phases.push_back({phase, 3});
+	}
+	expectOptimizedMatches("Day7", loadProgram("Day7.input.txt"), phases);
+	expectOptimizedMatches("Day9", loadProgram("Day9.input.txt"), {{1}, {2}});
+	for (const char* name : {"Day5.input.txt", "Day7.input.txt", "Day9.input.txt"})
+	{
+		expect(!analyzeProgram(loadProgram(name)).m_complete,
+		       std::string("analysis of ") + name + " is incomplete");
+	}
+
+	// in [110]; [111] = [100] + [101], folded; [112] = [110] * [111];
+	// [113] = [100] + [100], never read; out [112]; jump if [102] to [103],
+	// resolved; halt; [114] = [110] < 5; out [114]; halt
+	Program program{3, 110, 1, 100, 101, 111, 2, 110, 111, 112, 1, 100, 100, 113, 4, 112,
+	                5, 102, 103, 99, 1007, 110, 5, 114, 4, 114, 99};
+	program.resize(115);
+	program[100] = 3;
+	program[101] = 4;
+	program[102] = 1;
+	program[103] = 20;
+
+	OptimizedProgram optimized = optimizeProgram(program, analyzeProgram(program));
+	expect(optimized.m_immutableCode && optimized.m_constantOperands > 0 &&
+	           optimized.m_resolvedJumps > 0 && optimized.m_foldedInstructions > 0 &&
+	           optimized.m_deadStores > 0,
+	       "optimizer rewrites every kind of instruction it can");
+	expect(outputsOf(optimized.m_program, true, Runtime::Engine::Switch, {2}) ==
+	           std::vector<ProgramValue>{14, 1},
+	       "optimized program prints 14 and 1");
+	expectOptimizedMatches("program", program, {{2}, {7}});
+}
+
+// The example amplifier programs from input/, with the phases that give
+// the highest signal and that signal.
+struct AmplifierExample
+{
+	Program          m_program;
+	std::vector<int> m_phases;
+	ProgramValue     m_signal;
+};
+
+std::vector<AmplifierExample>
+chainExamples()
+{
+	return {{loadProgram("Day7.input.test1.txt"), {4, 3, 2, 1, 0}, 43210},
+	        {loadProgram("Day7.input.test2.txt"), {0, 1, 2, 3, 4}, 54321},
+	        {loadProgram("Day7.input.test3.txt"), {1, 0, 4, 3, 2}, 65210}};
+}
+
+std::vector<AmplifierExample>
+feedbackExamples()
+{
+	return {{{3, 26, 1001, 26, -4, 26, 3, 27, 1002, 27, 2, 27, 1, 27, 26, 27, 4, 27, 1001, 28, -1, 28,
+	          1005, 28, 6, 99, 0, 0, 5},
+	         {9, 8, 7, 6, 5},
+	         139629729},
+	        {{3, 52, 1001, 52, -5, 52, 3, 53, 1, 52, 56, 54, 1007, 54, 5, 55, 1005, 55, 26, 1001, 54,
+	          -5, 54, 1105, 1, 12, 1, 53, 54, 53, 1008, 54, 0, 55, 1001, 55, 1, 55, 2, 53, 55, 53, 4,
+	          53, 1001, 56, -1, 56, 1005, 56, 6, 99, 0, 0, 0, 0, 10},
+	         {9, 7, 8, 5, 6},
+	         18216}};
+}
+
+std::vector<Runtime>
+amplifiers(const AmplifierExample& example)
+{
+	std::vector<Runtime> stages;
+	for (int phase : example.m_phases)
+	{
+		stages.emplace_back(example.m_program);
+		stages.back().addInput(phase);
+	}
+	stages.front().addInput(0);
+	return stages;
+}
+
+// Runs stages in turn on this thread until none can make progress, moving
+// each stage's outputs to the next; the reference for pipeline::run().
+std::vector<ProgramValue>
+runInTurn(std::vector<Runtime>& stages, bool feedback)
+{
+	std::vector<ProgramValue> results;
+	for (bool progress = true; progress;)
+	{
+		progress = false;
+		for (size_t stage = 0; stage < stages.size(); ++stage)
+		{
+			bool last = stage + 1 == stages.size();
+			if (stages[stage].isHalted() ||
+			    (stages[stage].state() == Runtime::State::AwaitingInput && stages[stage].pendingInputs() == 0))
+			{
+				continue;
+			}
+			stages[stage].run();
+			progress = true;
+			while (auto output = stages[stage].getOutput())
+			{
+				if (last)
+				{
+					results.push_back(*output);
+				}
+				if (!last || feedback)
+				{
+					auto& next = stages[(stage + 1) % stages.size()];
+					if (!next.isHalted())
+					{
+						next.addInput(*output);
+					}
+				}
+			}
+		}
+	}
+	return results;
+}
+
+void
+pipelineAmplifiers()
+{
+	for (size_t capacity : {size_t{1}, io::batchSize})
+	{
+		for (const auto& example : chainExamples())
+		{
+			auto stages  = amplifiers(example);
+			auto outputs = pipeline::run(stages, false, capacity);
+			expect(outputs == std::vector<ProgramValue>{example.m_signal},
+			       "pipelined chain gives " + std::to_string(example.m_signal));
+		}
+		for (const auto& example : feedbackExamples())
+		{
+			auto stages  = amplifiers(example);
+			auto outputs = pipeline::run(stages, true, capacity);
+			expect(!outputs.empty() && outputs.back() == example.m_signal,
+			       "pipelined feedback loop gives " + std::to_string(example.m_signal));
+		}
+	}
+}
+
+// Streams many values through four stages that add one to each, until a
+// stage's output reaches a limit and it halts. With feedback the values
+// circle the ring. The result must not depend on the queue capacity, and
+// must match running the stages in turn.
+void
+pipelineStream()
+{
+	constexpr ProgramValue limit = 5000;
+	// in [20]; [20] += 1; out [20]; [21] = [20] < limit; if [21] goto 0; halt
+	Program increment{3, 20, 1001, 20, 1, 20, 4, 20, 1007, 20, limit, 21, 1005, 21, 0, 99, 0, 0, 0, 0, 0, 0};
+
+	for (bool feedback : {false, true})
+	{
+		auto streamed = [&]() {
+			std::vector<Runtime> stages;
+			for (int stage = 0; stage < 4; ++stage)
+			{
+				stages.emplace_back(increment);
+			}
+			for (ProgramValue value = 0; value < (feedback ? 16 : limit); ++value)
+			{
+				stages.front().addInput(value);
+			}
+			return stages;
+		};
+		auto reference = streamed();
+		auto expected  = runInTurn(reference, feedback);
+		for (size_t capacity : {size_t{2}, size_t{4096}})
+		{
+			auto stages = streamed();
+			expect(pipeline::run(stages, feedback, capacity) == expected,
+			       std::string("pipelined stream") + (feedback ? " with feedback" : "") + ", capacity " +
+			           std::to_string(capacity));
+		}
+	}
+}
+
+// Chains the amplifiers on a Network; the last keeps its outputs. With
+// feedback they are handed back to the first each time the network stops
+// for want of input, as Day7 does.
+std::vector<ProgramValue>
+networkSignals(const AmplifierExample& example, bool feedback)
+{
+	Network network(2);
+	for (auto& amplifier : amplifiers(example))
+	{
+		size_t index = network.add(std::move(amplifier));
+		if (index > 0)
+		{
+			network.connect(index - 1, index);
+		}
+	}
+	Runtime&                  first = network.machine(0);
+	Runtime&                  last  = network.machine(network.size() - 1);
+	std::vector<ProgramValue> signals;
+	for (bool halted = false; !halted;)
+	{
+		halted = network.run();
+		if (last.pendingOutputs() == 0)
+		{
+			break;
+		}
+		while (auto output = last.getOutput())
+		{
+			signals.push_back(*output);
+			if (feedback)
+			{
+				first.addInput(*output);
+			}
+		}
+	}
+	expect(network.blocked().empty(), "networked amplifiers all halt");
+	return signals;
+}
+
+void
+networkAmplifiers()
+{
+	for (const auto& example : chainExamples())
+	{
+		expect(networkSignals(example, false) == std::vector<ProgramValue>{example.m_signal},
+		       "networked chain gives " + std::to_string(example.m_signal));
+	}
+	for (const auto& example : feedbackExamples())
+	{
+		auto signals = networkSignals(example, true);
+		expect(!signals.empty() && signals.back() == example.m_signal,
+		       "networked feedback loop gives " + std::to_string(example.m_signal));
+	}
+}
+
+// Two machines that each wait for the other's output: the network goes
+// quiet with both blocked, and runs to the end once the host sends one a
+// value.
+void
+networkDeadlock()
+{
+	// in [9]; [9] += 1; out [9]; halt
+	Program increment{3, 9, 1001, 9, 1, 9, 4, 9, 99, 0};
+
+	Network network(2);
+	network.add(Runtime(increment));
+	network.add(Runtime(increment));
+	network.connect(0, 1);
+	network.connect(1, 0);
+	expect(!network.run(), "network reports deadlock");
+	expect(network.blocked() == std::vector<size_t>{0, 1}, "network names blocked machines");
+
+	network.machine(0).addInput(5);
+	expect(network.run(), "network runs after the host sends input");
+	expect(network.machine(1).read(9) == 7, "network passes values along");
+}
+
+// Many producers feeding one machine through a multi-producer channel:
+// every value arrives exactly once.
+void
+networkFanIn()
+{
+	constexpr size_t       producers = 8;
+	constexpr ProgramValue values    = 2000;
+	// loop: in [20]; if [20] == 0 halt; out [20]; goto loop
+	Program producer{3, 20, 1006, 20, 10, 4, 20, 1105, 1, 0, 99};
+	// loop: in [20]; out [20]; goto loop
+	Program echo{3, 20, 4, 20, 1105, 1, 0};
+	producer.resize(21);
+	echo.resize(21);
+
+	Network                   network(4);
+	size_t                    sink = network.add(Runtime(echo));
+	std::vector<ProgramValue> expected;
+	for (size_t i = 0; i < producers; ++i)
+	{
+		Runtime machine(producer);
+		for (ProgramValue value = 1; value <= values; ++value)
+		{
+			expected.push_back(ProgramValue(i) * values + value);
+			machine.addInput(expected.back());
+		}
+		machine.addInput(0);
+		network.connect(network.add(std::move(machine)), sink);
+	}
+	expect(!network.run() && network.blocked() == std::vector<size_t>{sink},
+	       "fan-in network stops with only the sink waiting");
+
+	std::vector<ProgramValue> received;
+	while (auto output = network.machine(sink).getOutput())
+	{
+		received.push_back(*output);
+	}
+	std::sort(received.begin(), received.end());
+	expect(received == expected, "fan-in network delivers every value once");
+}
+
+struct MachineState
+{
+	ProgramValue              m_instructionPointer{};
+	ProgramValue              m_relativeBase{};
+	std::vector<ProgramValue> m_memory;
+	std::vector<ProgramValue> m_outputs;
+
+	bool operator==(const MachineState&) const = default;
+};
+
+MachineState
+machineState(const TimeTravel& timeTravel, size_t words)
+{
+	const Runtime& machine = timeTravel.machine();
+	MachineState   state{machine.instructionPointer(), machine.relativeBase()};
+	for (size_t address = 0; address < words; ++address)
+	{
+		state.m_memory.push_back(machine.read(ProgramValue(address)));
+	}
+	state.m_outputs.assign(timeTravel.outputs().begin(), timeTravel.outputs().end());
+	return state;
+}
+
+// Steps back through Day9 part 2 by distances within the undo log, past it
+// and across snapshots, with snapshots small and few enough to have been
+// thinned several times. Stepping back must give the state of a fresh run
+// to the same position, and running forward again the state before.
+void
+timeTravelStepBack()
+{
+	Program           program = loadProgram("Day9.input.txt");
+	size_t            words   = program.size() + 1024;
+	TimeTravelOptions options{1000, 8, 300};
+	TimeTravel        timeTravel(program, options);
+	timeTravel.addInput(2);
+	timeTravel.run();
+	expect(timeTravel.state() == Runtime::State::Halted, "time travel runs Day9 to the end");
+	uint64_t end = timeTravel.position();
+	expect(end > options.m_snapshotInterval * options.m_maxSnapshots * 4,
+	       "time travel thins its snapshots");
+
+	for (uint64_t position : {end, end / 2 + 17})
+	{
+		expect(timeTravel.seek(position), "time travel seeks to " + std::to_string(position));
+		for (uint64_t distance : {uint64_t{1}, uint64_t{250}, uint64_t{2500}})
+		{
+			MachineState before = machineState(timeTravel, words);
+			for (uint64_t step = 0; step < distance; ++step)
+			{
+				timeTravel.stepBack();
+			}
+			std::string where = std::to_string(distance) + " back from " + std::to_string(position);
+			expect(timeTravel.position() == position - distance, "time travel steps " + where);
+
+			TimeTravel reference(program);
+			reference.addInput(2);
+			reference.run(position - distance);
+			expect(machineState(timeTravel, words) == machineState(reference, words),
+			       "time travel matches a fresh run " + where);
+
+			timeTravel.run(distance);
+			expect(timeTravel.position() == position && machineState(timeTravel, words) == before,
+			       "time travel reruns " + where);
+		}
+	}
+}
+
+// A crash while appending a checkpoint leaves a torn record; the machine
+// restores from the one before, and later checkpoints must not be lost
+// behind the torn one.
+void
+checkpointTornTail()
+{
+	// loop: in [20]; [21] += 1; goto loop
+	Program counter{3, 20, 1001, 21, 1, 21, 1105, 1, 0};
+	counter.resize(22);
+	auto path = (std::filesystem::temp_directory_path() / "IntcodeTest.checkpoint").string();
+
+	auto countTo = [](Runtime& runtime, ProgramValue count) {
+		while (runtime.read(21) < count)
+		{
+			runtime.addInput(0);
+			runtime.run();
+		}
+	};
+
+	Runtime runtime(counter);
+	countTo(runtime, 1);
+	runtime.checkpoint(path);
+	countTo(runtime, 2);
+	runtime.checkpoint(path);
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 16);
+
+	Runtime restored = Runtime::restore(path);
+	expect(restored.read(21) == 1, "checkpoint restores from before a torn record");
+	countTo(restored, 4);
+	restored.checkpoint(path);
+	expect(Runtime::restore(path).read(21) == 4, "checkpoint after a torn record restores");
+	restored.addInput(0);
+	restored.run();
+	restored.checkpoint(path);
+	expect(Runtime::restore(path).read(21) == 5, "checkpoint appends after a torn record");
+	std::filesystem::remove(path);
+}
+} // namespace
+
+int
+main()
+{
+	blockAtCacheLimit();
+	compiledFarJump();
+	callbackSourceEmptyRead();
+	batchAddresses();
+	optimizedPrograms();
+	pipelineAmplifiers();
+	pipelineStream();
+	networkAmplifiers();
+	networkDeadlock();
+	networkFanIn();
+	timeTravelStepBack();
+	checkpointTornTail();
+	if (failures == 0)
+	{
+		std::cout << "All checks passed" << std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}
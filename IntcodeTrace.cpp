@@ -0,0 +1,64 @@
+#include "Intcode.h"
+#include "Tracer.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Decodes traces written by a Runtime built with INTCODE_TRACE, printing
+// each instruction as Runtime itself prints it. With -v every line also
+// carries the instruction pointer, the operands and the value written.
+int
+main(int argc, char** argv)
+{
+	bool verbose = argc == 3 && std::strcmp(argv[1], "-v") == 0;
+	if (argc != 2 && !verbose)
+	{
+		std::cerr << "usage: " << argv[0] << " [-v] <trace.bin>" << std::endl;
+		return 1;
+	}
+	std::ifstream file(argv[argc - 1], std::ios::binary);
+	if (!file)
+	{
+		std::cerr << argv[argc - 1] << ": cannot open" << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		Tracer::read(file, [&](const Tracer::Record& record) {
+			Instruction instruction;
+			instruction.m_opCode        = static_cast<OpCode>(record.m_opCode);
+			instruction.m_numParameters = record.m_numParameters;
+			for (int i = 0; i < record.m_numParameters; ++i)
+			{
+				instruction.m_parameters[i] =
+				    Parameter{record.m_parameters[i], static_cast<ParameterMode>(record.m_modes[i])};
+			}
+			if (verbose)
+			{
+				std::cout << record.m_instructionPointer << ": ";
+			}
+			std::cout << instruction;
+			if (verbose)
+			{
+				std::cout << " <-";
+				for (int i = 0; i < record.m_numParameters; ++i)
+				{
+					std::cout << " " << record.m_operands[i];
+				}
+				if (record.m_hasWritten)
+				{
+					std::cout << " => " << record.m_written;
+				}
+			}
+			std::cout << '\n';
+		});
+	}
+	catch (const std::exception& error)
+	{
+		std::cerr << argv[argc - 1] << ": " << error.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,45 @@
+#include "Io.h"
+
+#include <cerrno>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace io
+{
+size_t
+readDescriptor(int descriptor, char* buffer, size_t size)
+{
+	for (;;)
+	{
+		ssize_t count = ::read(descriptor, buffer, size);
+		if (count >= 0)
+		{
+			return static_cast<size_t>(count);
+		}
+		if (errno != EINTR)
+		{
+			throw std::system_error(errno, std::generic_category(), "read");
+		}
+	}
+}
+
+void
+writeDescriptor(int descriptor, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t count = ::write(descriptor, data, size);
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "write");
+		}
+		data += count;
+		size -= static_cast<size_t>(count);
+	}
+}
+} // namespace io
@@ -0,0 +1,424 @@
+#pragma once
+
+#include "Intcode.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Pluggable input sources and output sinks for a machine. pump() runs a
+// machine, moving values between it and a source and a sink in batches;
+// both are template parameters, so the per-value work inlines into the
+// batch loops.
+//
+// A source fills a span with its next values and returns how many it
+// wrote, 0 once it has none left. A sink takes spans of outputs and keeps
+// them until it is flushed: sinks that write to a descriptor only do so
+// when their buffer fills or on flush(), which pump() calls once when it
+// returns. Text sources accept decimal values separated by commas or
+// whitespace; text sinks write one value per line.
+namespace io
+{
+// Reads at most size bytes, retrying on EINTR; returns 0 at end of file.
+// Both throw std::system_error on failure.
+size_t readDescriptor(int descriptor, char* buffer, size_t size);
+void   writeDescriptor(int descriptor, const char* data, size_t size);
+
+namespace detail
+{
+inline bool
+isSeparator(char c)
+{
+	return c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Parses values from [first, last) into values and advances first past
+// them. Unless atEnd, a value running up to last may continue in data not
+// read yet, so it is left for the next call.
+template <typename Word>
+size_t
+parseValues(const char*& first, const char* last, bool atEnd, std::span<Word> values)
+{
+	// from_chars has no 128-bit overload; wide words read 64-bit values.
+	using Parsed = std::conditional_t<(sizeof(Word) > sizeof(ProgramValue)), ProgramValue, Word>;
+
+	size_t count = 0;
+	while (count < values.size())
+	{
+		while (first != last && isSeparator(*first))
+		{
+			++first;
+		}
+		const char* end = std::find_if(first, last, isSeparator);
+		if (first == last || (end == last && !atEnd))
+		{
+			break;
+		}
+		Parsed value{};
+		auto [next, error] = std::from_chars(first, end, value);
+		if (error != std::errc() || next != end)
+		{
+			throw std::runtime_error("input: malformed value '" + std::string(first, end) + "'");
+		}
+		values[count++] = value;
+		first           = end;
+	}
+	return count;
+}
+
+// Room formatValue() needs, including the separator.
+constexpr size_t maxFormattedLength = 48;
+
+template <typename Word>
+char*
+formatValue(char* out, Word value)
+{
+	if constexpr (sizeof(Word) > sizeof(ProgramValue))
+	{
+		std::ostringstream stream;
+		stream << value;
+		std::string text = stream.str();
+		return std::copy(text.begin(), text.end(), out);
+	}
+	else
+	{
+		return std::to_chars(out, out + maxFormattedLength, value).ptr;
+	}
+}
+} // namespace detail
+
+template <typename Word>
+class SpanSource
+{
+public:
+	explicit SpanSource(std::span<const Word> values)
+	    : m_values(values)
+	{
+	}
+
+	size_t
+	read(std::span<Word> values)
+	{
+		size_t count = std::min(values.size(), m_values.size());
+		std::copy_n(m_values.begin(), count, values.begin());
+		m_values = m_values.subspan(count);
+		return count;
+	}
+
+private:
+	std::span<const Word> m_values;
+};
+
+// Buffered text from a file descriptor. It only blocks when no complete
+// value is buffered, so a terminal or pipe is consumed as values arrive.
+template <typename Word>
+class FdSource
+{
+public:
+	static constexpr size_t bufferSize = size_t{1} << 16;
+
+	explicit FdSource(int descriptor)
+	    : m_descriptor(descriptor)
+	    , m_buffer(bufferSize)
+	{
+	}
+
+	size_t
+	read(std::span<Word> values)
+	{
+		for (;;)
+		{
+			const char* first = m_buffer.data() + m_begin;
+			size_t      count =
+			    detail::parseValues(first, m_buffer.data() + m_end, m_atEnd, values);
+			m_begin = first - m_buffer.data();
+			if (count > 0 || m_atEnd)
+			{
+				return count;
+			}
+			refill();
+		}
+	}
+
+private:
+	void
+	refill()
+	{
+		std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+		m_end -= m_begin;
+		m_begin = 0;
+		if (m_end == m_buffer.size())
+		{
+			throw std::runtime_error("input: value longer than the buffer");
+		}
+		size_t read = readDescriptor(m_descriptor, m_buffer.data() + m_end,
+		                             m_buffer.size() - m_end);
+		m_end += read;
+		m_atEnd = read == 0;
+	}
+
+	int               m_descriptor;
+	std::vector<char> m_buffer;
+	size_t            m_begin{};
+	size_t            m_end{};
+	bool              m_atEnd{};
+};
+
+// Text from a memory-mapped file, parsed in place.
+template <typename Word>
+class MappedSource
+{
+public:
+	explicit MappedSource(const std::string& fileName)
+	    : m_file(fileName)
+	    , m_next(m_file.text().data())
+	{
+	}
+
+	size_t
+	read(std::span<Word> values)
+	{
+		return detail::parseValues(m_next, m_file.text().data() + m_file.text().size(), true,
+		                           values);
+	}
+
+private:
+	MappedFile  m_file;
+	const char* m_next;
+};
+
+// Calls next() once each time the machine waits for input; an empty
+// std::optional ends the input.
+template <typename Word, typename Next>
+class CallbackSource
+{
+public:
+	explicit CallbackSource(Next next)
+	    : m_next(std::move(next))
+	{
+	}
+
+	size_t
+	read(std::span<Word> values)
+	{
+		// An empty read must not consume a value it has nowhere to put.
+		if (values.empty())
+		{
+			return 0;
+		}
+		std::optional<Word> value = m_next();
+		if (!value)
+		{
+			return 0;
+		}
+		values[0] = *value;
+		return 1;
+	}
+
+private:
+	Next m_next;
+};
+
+template <typename Word, typename Next>
+CallbackSource<Word, Next>
+callbackSource(Next next)
+{
+	return CallbackSource<Word, Next>(std::move(next));
+}
+
+template <typename Word>
+class VectorSink
+{
+public:
+	explicit VectorSink(std::vector<Word>& values)
+	    : m_values(values)
+	{
+	}
+
+	void
+	write(std::span<const Word> values)
+	{
+		m_values.insert(m_values.end(), values.begin(), values.end());
+	}
+
+	void
+	flush()
+	{
+	}
+
+private:
+	std::vector<Word>& m_values;
+};
+
+// Fills a caller-owned span; throws std::length_error if it overflows.
+template <typename Word>
+class SpanSink
+{
+public:
+	explicit SpanSink(std::span<Word> values)
+	    : m_values(values)
+	{
+	}
+
+	void
+	write(std::span<const Word> values)
+	{
+		if (values.size() > m_values.size() - m_size)
+		{
+			throw std::length_error("output: span sink is full");
+		}
+		std::copy(values.begin(), values.end(), m_values.begin() + m_size);
+		m_size += values.size();
+	}
+
+	void
+	flush()
+	{
+	}
+
+	size_t
+	size() const
+	{
+		return m_size;
+	}
+
+private:
+	std::span<Word> m_values;
+	size_t          m_size{};
+};
+
+// Buffered text to a file descriptor, one value per line. Written when the
+// buffer fills, on flush() and on destruction.
+template <typename Word>
+class FdSink
+{
+public:
+	static constexpr size_t bufferSize = size_t{1} << 16;
+
+	explicit FdSink(int descriptor)
+	    : m_descriptor(descriptor)
+	    , m_buffer(bufferSize)
+	{
+	}
+
+	FdSink(const FdSink&) = delete;
+	FdSink& operator=(const FdSink&) = delete;
+
+	~FdSink()
+	{
+		try
+		{
+			flush();
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	void
+	write(std::span<const Word> values)
+	{
+		for (Word value : values)
+		{
+			if (m_buffer.size() - m_size < detail::maxFormattedLength)
+			{
+				flush();
+			}
+			char* end = detail::formatValue(m_buffer.data() + m_size, value);
+			*end++    = '\n';
+			m_size    = end - m_buffer.data();
+		}
+	}
+
+	void
+	flush()
+	{
+		writeDescriptor(m_descriptor, m_buffer.data(), m_size);
+		m_size = 0;
+	}
+
+private:
+	int               m_descriptor;
+	std::vector<char> m_buffer;
+	size_t            m_size{};
+};
+
+// Calls write(value) for every output.
+template <typename Word, typename Write>
+class CallbackSink
+{
+public:
+	explicit CallbackSink(Write write)
+	    : m_write(std::move(write))
+	{
+	}
+
+	void
+	write(std::span<const Word> values)
+	{
+		for (Word value : values)
+		{
+			m_write(value);
+		}
+	}
+
+	void
+	flush()
+	{
+	}
+
+private:
+	Write m_write;
+};
+
+template <typename Word, typename Write>
+CallbackSink<Word, Write>
+callbackSink(Write write)
+{
+	return CallbackSink<Word, Write>(std::move(write));
+}
+
+// Values moved per batch between a machine and its source or sink.
+constexpr size_t batchSize = 4096;
+
+// Runs the machine until it halts, or waits for input the source no longer
+// has, or stops for any other reason; sends every output to the sink and
+// flushes it. Returns the machine's final state.
+template <typename Machine, typename Source, typename Sink>
+RuntimeBase::State
+pump(Machine& machine, Source& source, Sink& sink)
+{
+	using Word = typename Machine::Value;
+
+	std::array<Word, batchSize> buffer;
+	for (;;)
+	{
+		machine.run();
+		while (size_t count = machine.drainOutputs(buffer))
+		{
+			sink.write(std::span<const Word>(buffer.data(), count));
+		}
+		if (machine.state() != RuntimeBase::State::AwaitingInput)
+		{
+			break;
+		}
+		size_t count = source.read(buffer);
+		if (count == 0)
+		{
+			break;
+		}
+		machine.addInputs(std::span<const Word>(buffer.data(), count));
+	}
+	sink.flush();
+	return machine.state();
+}
+} // namespace io
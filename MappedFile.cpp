@@ -0,0 +1,40 @@
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& fileName, bool copyOnWrite)
+{
+	int descriptor = ::open(fileName.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		throw std::runtime_error(fileName + ": " + std::strerror(errno));
+	}
+	struct stat status;
+	if (::fstat(descriptor, &status) == 0 && status.st_size > 0)
+	{
+		m_size = static_cast<size_t>(status.st_size);
+		m_data = ::mmap(nullptr, m_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+		                MAP_PRIVATE, descriptor, 0);
+	}
+	int error = errno;
+	::close(descriptor);
+	if (m_data == MAP_FAILED)
+	{
+		throw std::runtime_error(fileName + ": " + std::strerror(error));
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_size > 0)
+	{
+		::munmap(m_data, m_size);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only mapping of a whole file, unmapped on destruction. Throws
+// std::runtime_error naming the file if it cannot be opened or mapped.
+// A copy-on-write mapping is private and writable: stores go to private
+// copies of the pages they touch and never reach the file.
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& fileName, bool copyOnWrite = false);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile();
+
+	std::string_view
+	text() const
+	{
+		return m_size > 0 ? std::string_view(static_cast<const char*>(m_data), m_size)
+		                  : std::string_view();
+	}
+
+	// Null for an empty file; only writable through a copy-on-write mapping.
+	void*
+	data() const
+	{
+		return m_size > 0 ? m_data : nullptr;
+	}
+
+	size_t
+	size() const
+	{
+		return m_size;
+	}
+
+private:
+	void*  m_data{};
+	size_t m_size{};
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Intcode memory with full 64-bit addressing. Low addresses, including the
+// program image, are reached through a flat page table whose untouched
+// entries all point at one shared zero page, so reads never branch on
+// whether a page exists. Pages above the table live in a hash map. Pages are
+// allocated on first write, so memory use tracks the pages actually touched.
+//
+// Pages are reference counted and shared copy-on-write between a memory and
+// its forks: a write goes straight to a page only when this memory is known
+// to own it exclusively, and otherwise copies the page first.
+template <typename Word>
+class PagedMemory
+{
+public:
+	static constexpr int      pageBits      = 10;
+	static constexpr uint64_t pageSize      = uint64_t{1} << pageBits;
+	static constexpr uint64_t pageMask      = pageSize - 1;
+	static constexpr uint64_t maxTablePages = uint64_t{1} << 16;
+
+	using Page = std::array<Word, pageSize>;
+
+	PagedMemory() = default;
+
+	// Values are converted to Word, so a narrow memory can load a program
+	// read as 64-bit values.
+	template <typename Value>
+	explicit PagedMemory(const std::vector<Value>& image)
+	{
+		uint64_t pages = (image.size() + pageMask) >> pageBits;
+		m_table.resize(pages, zeroPage());
+		m_writable.resize(pages);
+		m_owners.resize(pages);
+		for (uint64_t address = 0; address < image.size(); ++address)
+		{
+			if (image[address] != 0)
+			{
+				write(address, static_cast<Word>(image[address]));
+			}
+		}
+	}
+
+	PagedMemory(const PagedMemory&) = delete;
+	PagedMemory& operator=(const PagedMemory&) = delete;
+	PagedMemory(PagedMemory&&)                 = default;
+	PagedMemory& operator=(PagedMemory&&) = default;
+
+	// Shares every page with the returned memory. Both sides lose direct
+	// write access and copy a page the first time they write to it, so a
+	// fork costs one pointer per page plus the pages later written.
+	PagedMemory
+	fork()
+	{
+		PagedMemory forked;
+		forked.m_table  = m_table;
+		forked.m_owners = m_owners;
+		forked.m_sparse = m_sparse;
+		forked.m_writable.resize(m_writable.size());
+		std::fill(m_writable.begin(), m_writable.end(), nullptr);
+		return forked;
+	}
+
+	[[gnu::always_inline]] Word
+	read(uint64_t address) const
+	{
+		uint64_t page = address >> pageBits;
+		if (page < m_table.size()) [[likely]]
+		{
+			return (*m_table[page])[address & pageMask];
+		}
+		return readSparse(address);
+	}
+
+	Word
+	operator[](uint64_t address) const
+	{
+		return read(address);
+	}
+
+	[[gnu::always_inline]] void
+	write(uint64_t address, Word value)
+	{
+		uint64_t page = address >> pageBits;
+		if (page < m_writable.size() && m_writable[page]) [[likely]]
+		{
+			(*m_writable[page])[address & pageMask] = value;
+			return;
+		}
+		writeSlow(address, value);
+	}
+
+	// Extent of the flat page table in words; everything below it can be
+	// read without touching the hash map.
+	uint64_t
+	tableSize() const
+	{
+		return m_table.size() * pageSize;
+	}
+
+	// Calls visit(firstAddress, page) for every page that has been written.
+	template <typename Visit>
+	void
+	forEachPage(Visit visit) const
+	{
+		for (uint64_t page = 0; page < m_owners.size(); ++page)
+		{
+			if (m_owners[page])
+			{
+				visit(page << pageBits, *m_owners[page]);
+			}
+		}
+		for (const auto& [page, contents] : m_sparse)
+		{
+			visit(page << pageBits, *contents);
+		}
+	}
+
+	// Starts, or restarts, tracking which pages are written. Direct write
+	// access is dropped as by fork(), so the next write to each page takes
+	// the slow path, which marks it; a tracked interval costs one slow write
+	// per page written.
+	void
+	clearDirty()
+	{
+		std::fill(m_writable.begin(), m_writable.end(), nullptr);
+		m_dirty.clear();
+		m_trackDirty = true;
+	}
+
+	// Calls visit(firstAddress, page) for every page written since
+	// clearDirty(), in address order.
+	template <typename Visit>
+	void
+	forEachDirtyPage(Visit visit) const
+	{
+		std::vector<uint64_t> pages(m_dirty.begin(), m_dirty.end());
+		std::sort(pages.begin(), pages.end());
+		for (uint64_t page : pages)
+		{
+			visit(page << pageBits, page < m_owners.size() ? *m_owners[page] : *m_sparse.at(page));
+		}
+	}
+
+	// Installs contents as a page, shared copy-on-write as with a fork: the
+	// first write to it copies it unless this memory holds the only
+	// reference.
+	void
+	adopt(uint64_t page, std::shared_ptr<Page> contents)
+	{
+		if (page < maxTablePages)
+		{
+			if (page >= m_table.size())
+			{
+				m_table.resize(page + 1, zeroPage());
+				m_writable.resize(page + 1);
+				m_owners.resize(page + 1);
+			}
+			m_table[page]    = contents.get();
+			m_writable[page] = nullptr;
+			m_owners[page]   = std::move(contents);
+			return;
+		}
+		m_sparse[page] = std::move(contents);
+	}
+
+	size_t
+	pagesAllocated() const
+	{
+		size_t pages = m_sparse.size();
+		for (const auto& owner : m_owners)
+		{
+			pages += owner != nullptr;
+		}
+		return pages;
+	}
+
+private:
+	static Page*
+	zeroPage()
+	{
+		static Page page{};
+		return &page;
+	}
+
+	// Returns a page this memory may write to, copying it if it is shared.
+	static Page*
+	exclusive(std::shared_ptr<Page>& owner)
+	{
+		if (!owner)
+		{
+			owner = std::make_shared<Page>();
+		}
+		else if (owner.use_count() > 1)
+		{
+			owner = std::make_shared<Page>(*owner);
+		}
+		return owner.get();
+	}
+
+	Word
+	readSparse(uint64_t address) const
+	{
+		auto it = m_sparse.find(address >> pageBits);
+		return it == m_sparse.end() ? Word{} : (*it->second)[address & pageMask];
+	}
+
+	void
+	writeSlow(uint64_t address, Word value)
+	{
+		uint64_t page = address >> pageBits;
+		if (m_trackDirty)
+		{
+			m_dirty.insert(page);
+		}
+		if (page < maxTablePages)
+		{
+			if (page >= m_table.size())
+			{
+				m_table.resize(page + 1, zeroPage());
+				m_writable.resize(page + 1);
+				m_owners.resize(page + 1);
+			}
+			Page* contents   = exclusive(m_owners[page]);
+			m_table[page]    = contents;
+			m_writable[page] = contents;
+			(*contents)[address & pageMask] = value;
+			return;
+		}
+		(*exclusive(m_sparse[page]))[address & pageMask] = value;
+	}
+
+	std::vector<Page*>                                  m_table;
+	std::vector<Page*>                                  m_writable;
+	std::vector<std::shared_ptr<Page>>                  m_owners;
+	std::unordered_map<uint64_t, std::shared_ptr<Page>> m_sparse;
+	std::unordered_set<uint64_t>                        m_dirty;
+	bool                                                m_trackDirty{};
+};
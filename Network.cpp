@@ -0,0 +1,188 @@
+#include "Network.h"
+#include "Io.h"
+
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
+Network::Network(size_t threads)
+    : m_pool(threads)
+{
+}
+
+size_t
+Network::add(Runtime machine)
+{
+	m_nodes.push_back(std::make_unique<Node>(std::move(machine)));
+	return m_nodes.size() - 1;
+}
+
+Runtime&
+Network::machine(size_t index)
+{
+	return m_nodes[index]->m_machine;
+}
+
+size_t
+Network::size() const
+{
+	return m_nodes.size();
+}
+
+void
+Network::connect(size_t from, size_t to)
+{
+	if (m_started || m_nodes[from]->m_target)
+	{
+		throw std::logic_error("Network: connect() after run() or to a second target");
+	}
+	m_nodes[from]->m_target = to;
+	++m_nodes[to]->m_producers;
+}
+
+bool
+Network::run()
+{
+	if (!m_started)
+	{
+		for (auto& node : m_nodes)
+		{
+			if (node->m_producers == 1)
+			{
+				node->m_input.emplace<SpscQueue<ProgramValue>>();
+			}
+			else if (node->m_producers > 1)
+			{
+				node->m_input.emplace<MpscQueue<ProgramValue>>();
+			}
+		}
+		m_started = true;
+	}
+
+	std::vector<size_t> runnable;
+	for (size_t index = 0; index < m_nodes.size(); ++index)
+	{
+		if (!m_nodes[index]->m_machine.isHalted())
+		{
+			m_nodes[index]->m_status = Status::Scheduled;
+			runnable.push_back(index);
+		}
+	}
+	m_active = runnable.size();
+	for (size_t index : runnable)
+	{
+		m_pool.submit([this, index] { step(index); });
+	}
+
+	std::unique_lock<std::mutex> lock(m_quiescentMutex);
+	m_quiescent.wait(lock, [this] { return m_active.load() == 0; });
+	return blocked().empty();
+}
+
+std::vector<size_t>
+Network::blocked() const
+{
+	std::vector<size_t> ret;
+	for (size_t index = 0; index < m_nodes.size(); ++index)
+	{
+		if (m_nodes[index]->m_machine.state() == RuntimeBase::State::AwaitingInput)
+		{
+			ret.push_back(index);
+		}
+	}
+	return ret;
+}
+
+// Runs one machine until it cannot go on, then parks it. Only one step()
+// per machine runs at a time, which makes it the single consumer of its
+// channel.
+void
+Network::step(size_t index)
+{
+	Node&                                   node = *m_nodes[index];
+	std::array<ProgramValue, io::batchSize> buffer;
+	for (;;)
+	{
+		std::visit(
+		    [&](auto& input) {
+			    if constexpr (!std::is_same_v<std::decay_t<decltype(input)>, std::monostate>)
+			    {
+				    input.consume([&](std::span<const ProgramValue> values) {
+					    node.m_machine.addInputs(values);
+				    });
+			    }
+		    },
+		    node.m_input);
+
+		// Values sent to a halted machine are dropped.
+		if (!node.m_machine.isHalted())
+		{
+			node.m_machine.run();
+		}
+		if (node.m_target && node.m_machine.pendingOutputs() > 0)
+		{
+			while (size_t count = node.m_machine.drainOutputs(buffer))
+			{
+				send(*node.m_target, std::span<const ProgramValue>(buffer.data(), count));
+			}
+			wake(*node.m_target);
+		}
+
+		// Producers only move a scheduled machine to Notified, so failing to
+		// park means more input may have arrived. Once parked, the node
+		// belongs to whichever producer wakes it next.
+		Status expected = Status::Scheduled;
+		if (node.m_status.compare_exchange_strong(expected, Status::Parked))
+		{
+			break;
+		}
+		node.m_status = Status::Scheduled;
+	}
+	finished();
+}
+
+void
+Network::send(size_t target, std::span<const ProgramValue> values)
+{
+	std::visit(
+	    [&](auto& input) {
+		    if constexpr (!std::is_same_v<std::decay_t<decltype(input)>, std::monostate>)
+		    {
+			    input.push(values);
+		    }
+	    },
+	    m_nodes[target]->m_input);
+}
+
+// Called by a running machine, whose own count keeps the network active
+// until the woken machine has been counted. A machine that is already
+// scheduled is only told to look at its channel again before it parks.
+void
+Network::wake(size_t index)
+{
+	std::atomic<Status>& status   = m_nodes[index]->m_status;
+	Status               expected = status.load();
+	while (expected != Status::Notified)
+	{
+		Status next = expected == Status::Parked ? Status::Scheduled : Status::Notified;
+		if (status.compare_exchange_weak(expected, next))
+		{
+			if (expected == Status::Parked)
+			{
+				m_active.fetch_add(1);
+				m_pool.submit([this, index] { step(index); });
+			}
+			return;
+		}
+	}
+}
+
+void
+Network::finished()
+{
+	if (m_active.fetch_sub(1) == 1)
+	{
+		std::lock_guard<std::mutex> lock(m_quiescentMutex);
+		m_quiescent.notify_all();
+	}
+}
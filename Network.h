@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Channel.h"
+#include "Intcode.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// Runs a network of machines, each one's outputs wired to another's input,
+// on a work-stealing pool it owns. A machine runs on a worker until it
+// halts or waits for input; its outputs are then pushed down a lock-free
+// channel to the machine it feeds, which is woken if it was parked. A
+// machine blocked on input is parked, taking no worker, until a value
+// arrives. A channel is single-producer when one machine feeds it and
+// multi-producer otherwise.
+//
+// Every machine that is scheduled or running holds one count of an active
+// counter, and a producer wakes a consumer before giving up its own count,
+// so the counter only reaches zero when the network is quiescent: nothing
+// can run and no value is in flight. run() sleeps until then instead of
+// polling. If a machine is still waiting for input at that point, the
+// network is deadlocked.
+class Network
+{
+public:
+	explicit Network(size_t threads = std::thread::hardware_concurrency());
+
+	Network(const Network&) = delete;
+	Network& operator=(const Network&) = delete;
+
+	// Returns the machine's index. Inputs added to it before run() come
+	// before anything sent over its channel.
+	size_t   add(Runtime machine);
+	Runtime& machine(size_t index);
+	size_t   size() const;
+	// Sends every output of from to the input of to. A machine without a
+	// connection keeps its outputs for the host. Throws std::logic_error if
+	// from is already connected or the network has run.
+	void     connect(size_t from, size_t to);
+
+	// Runs the network until it is quiescent. Returns true if every machine
+	// halted, false on deadlock; see blocked(). The host may then add
+	// inputs and run it again.
+	bool                run();
+	// Machines waiting for input that never came.
+	std::vector<size_t> blocked() const;
+
+private:
+	using Input = std::variant<std::monostate, SpscQueue<ProgramValue>, MpscQueue<ProgramValue>>;
+
+	enum class Status : uint8_t
+	{
+		Parked,
+		Scheduled,
+		// Scheduled, and sent more values since it last took its input.
+		Notified
+	};
+
+	struct Node
+	{
+		explicit Node(Runtime machine)
+		    : m_machine(std::move(machine))
+		{
+		}
+
+		Runtime               m_machine;
+		std::optional<size_t> m_target;
+		size_t                m_producers{};
+		Input                 m_input;
+		std::atomic<Status>   m_status{Status::Parked};
+	};
+
+	void step(size_t index);
+	void send(size_t target, std::span<const ProgramValue> values);
+	void wake(size_t index);
+	void finished();
+
+	std::vector<std::unique_ptr<Node>> m_nodes;
+	bool                               m_started{};
+	std::atomic<size_t>                m_active{};
+	std::mutex                         m_quiescentMutex;
+	std::condition_variable            m_quiescent;
+	// Last, so it joins its workers before anything they use is destroyed.
+	WorkStealingPool                   m_pool;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Channel.h"
+#include "Io.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Runs a chain of machines as a pipeline, each stage on its own thread and
+// feeding the next through a bounded queue of the given capacity. With
+// feedback the last stage also feeds the first, closing the loop. Inputs
+// for the first stage are added to it beforehand. Returns every output of
+// the last stage once all stages have stopped; a stage stops when its
+// machine halts, or when it waits for input and its producer has stopped.
+//
+// A stage moves its machine's outputs on in batches of up to io::batchSize,
+// as many as the next queue has room for, and wakes the next stage once per
+// batch. Each stage sleeps on a single counter, bumped by its producer when
+// values arrive and by its consumer when room frees up, so it can wait for
+// either. A stage whose next queue is full stops running its machine until
+// all its outputs have moved on, so a slow consumer holds back its
+// producer; a single run can still leave more outputs than the queue holds.
+// It still takes in its own input, which its machine buffers, so a full
+// ring cannot deadlock. Values sent to a stage that has stopped are dropped.
+namespace pipeline
+{
+template <typename Machine>
+std::vector<typename Machine::Value>
+run(std::vector<Machine>& stages, bool feedback, size_t capacity = io::batchSize)
+{
+	using Value = typename Machine::Value;
+
+	struct Link
+	{
+		explicit Link(size_t capacity)
+		    : m_queue(capacity)
+		{
+		}
+
+		BoundedSpscQueue<Value> m_queue;
+		std::atomic<bool>       m_producerStopped{};
+		std::atomic<bool>       m_consumerStopped{};
+	};
+
+	struct alignas(64) Signal
+	{
+		std::atomic<uint32_t> m_count{};
+	};
+
+	size_t numStages = stages.size();
+	// Link i feeds stage i; the first only exists with feedback.
+	std::vector<std::unique_ptr<Link>> links;
+	for (size_t i = 0; i < numStages; ++i)
+	{
+		links.push_back(i > 0 || feedback ? std::make_unique<Link>(capacity) : nullptr);
+	}
+	std::vector<Signal> signals(numStages);
+	std::vector<Value>  results;
+
+	auto wake = [&](size_t stage) {
+		signals[stage].m_count.fetch_add(1, std::memory_order_release);
+		signals[stage].m_count.notify_one();
+	};
+
+	auto runStage = [&](size_t stage) {
+		Machine& machine  = stages[stage];
+		Link*    input    = links[stage].get();
+		Link*    output   = links[(stage + 1) % numStages].get();
+		size_t   producer = (stage + numStages - 1) % numStages;
+		size_t   consumer = (stage + 1) % numStages;
+		bool     last     = stage + 1 == numStages;
+		if (last && !feedback)
+		{
+			output = nullptr;
+		}
+
+		std::array<Value, io::batchSize> buffer;
+		// Moves pending outputs on as room allows; returns false if some
+		// are left because the next queue is full.
+		auto drain = [&]() {
+			while (machine.pendingOutputs() > 0)
+			{
+				bool   dropped = !output || output->m_consumerStopped.load(std::memory_order_acquire);
+				size_t room    = dropped ? buffer.size()
+				                         : std::min(output->m_queue.room(), buffer.size());
+				if (room == 0)
+				{
+					return false;
+				}
+				size_t count = machine.drainOutputs(std::span<Value>(buffer.data(), room));
+				if (last)
+				{
+					results.insert(results.end(), buffer.begin(), buffer.begin() + count);
+				}
+				if (!dropped)
+				{
+					output->m_queue.push(std::span<const Value>(buffer.data(), count));
+					wake(consumer);
+				}
+			}
+			return true;
+		};
+
+		for (;;)
+		{
+			uint32_t seen = signals[stage].m_count.load(std::memory_order_acquire);
+			// Read before taking input, so nothing sent before the producer
+			// stopped is missed.
+			bool starved = !input || input->m_producerStopped.load(std::memory_order_acquire);
+			if (input)
+			{
+				while (size_t count = input->m_queue.pop(buffer))
+				{
+					machine.addInputs(std::span<const Value>(buffer.data(), count));
+					wake(producer);
+				}
+			}
+			// Outputs left over from the last run go first; the machine only
+			// runs again once they have all moved on.
+			bool full = !drain();
+			if (!full && !machine.isHalted())
+			{
+				machine.run();
+				full = !drain();
+			}
+			if (!full && (machine.state() != Machine::State::AwaitingInput || starved))
+			{
+				break;
+			}
+			signals[stage].m_count.wait(seen, std::memory_order_acquire);
+		}
+
+		if (input)
+		{
+			input->m_consumerStopped.store(true, std::memory_order_release);
+			wake(producer);
+		}
+		if (output)
+		{
+			output->m_producerStopped.store(true, std::memory_order_release);
+			wake(consumer);
+		}
+	};
+
+	std::vector<std::jthread> threads;
+	for (size_t stage = 0; stage < numStages; ++stage)
+	{
+		threads.emplace_back(runStage, stage);
+	}
+	threads.clear();
+	return results;
+}
+} // namespace pipeline
@@ -0,0 +1,209 @@
+#include "Profiler.h"
+
+#include "Intcode.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+std::atomic<uint64_t> nextMachine{0};
+
+std::string
+opCodeName(uint8_t opCode)
+{
+	std::ostringstream name;
+	name << static_cast<OpCode>(opCode);
+	return name.str();
+}
+
+const char*
+eventName(Profiler::Event event)
+{
+	return event == Profiler::Event::Input ? "input" : "output";
+}
+
+bool
+endsWith(const std::string& text, const std::string& suffix)
+{
+	return text.size() >= suffix.size() &&
+	       text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+} // namespace
+
+Profiler::Profiler()
+    : m_machine(nextMachine++)
+    , m_lastIo(Clock::now())
+{
+}
+
+void
+Profiler::countSlow(std::vector<uint64_t>& dense, Histogram& sparse, uint64_t index,
+                    int64_t times)
+{
+	if (index >= maxDense)
+	{
+		sparse[index] += times;
+		return;
+	}
+	dense.resize(std::max<size_t>(2 * dense.size(), index + 1));
+	dense[index] += times;
+}
+
+// Visits non-zero counters in ascending index order.
+template <typename Visit>
+void
+Profiler::forEachCount(const std::vector<uint64_t>& dense, const Histogram& sparse,
+                       Visit visit)
+{
+	for (uint64_t index = 0; index < dense.size(); ++index)
+	{
+		if (dense[index] != 0)
+		{
+			visit(index, dense[index]);
+		}
+	}
+	std::vector<std::pair<uint64_t, uint64_t>> sorted(sparse.begin(), sparse.end());
+	std::sort(sorted.begin(), sorted.end());
+	for (const auto& [index, count] : sorted)
+	{
+		visit(index, count);
+	}
+}
+
+void
+Profiler::io(Event event, uint64_t instructionPointer)
+{
+	Clock::time_point now = Clock::now();
+	m_ioEvents.push_back(IoEvent{
+	    event, instructionPointer,
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_lastIo).count()});
+	m_lastIo = now;
+}
+
+void
+Profiler::halted() const
+{
+	static std::mutex mutex;
+
+	const char* variable = std::getenv("INTCODE_PROFILE_OUTPUT");
+	std::string path     = variable ? variable : "intcode-profile.json";
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ofstream               file(path, std::ios::app);
+	if (endsWith(path, ".csv"))
+	{
+		writeCsv(file);
+	}
+	else
+	{
+		writeJson(file);
+		file << '\n';
+	}
+}
+
+void
+Profiler::writeJson(std::ostream& stream) const
+{
+	stream << "{\"machine\":" << m_machine << ",\"opcodes\":{";
+	const char* separator = "";
+	for (size_t opCode = 0; opCode < m_opCodes.size(); ++opCode)
+	{
+		if (m_opCodes[opCode] != 0)
+		{
+			stream << separator << '"' << opCodeName(opCode) << "\":" << m_opCodes[opCode];
+			separator = ",";
+		}
+	}
+
+	auto writeCounts = [&](const char* name, const std::vector<uint64_t>& dense,
+	                       const Histogram& sparse, uint64_t scale) {
+		stream << ",\"" << name << "\":[";
+		const char* separator = "";
+		forEachCount(dense, sparse, [&](uint64_t index, uint64_t count) {
+			stream << separator << '[' << index * scale << ',' << count << ']';
+			separator = ",";
+		});
+		stream << ']';
+	};
+	stream << '}';
+	writeCounts("instructions", m_hits, m_sparseHits, 1);
+	stream << ",\"heatSize\":" << heatSize;
+	writeCounts("reads", m_reads, m_sparseReads, heatSize);
+	writeCounts("writes", m_writes, m_sparseWrites, heatSize);
+
+	stream << ",\"io\":[";
+	separator = "";
+	for (const auto& event : m_ioEvents)
+	{
+		stream << separator << "{\"event\":\"" << eventName(event.m_event)
+		       << "\",\"ip\":" << event.m_instructionPointer
+		       << ",\"ns\":" << event.m_nanosecondsSincePrevious << '}';
+		separator = ",";
+	}
+	stream << "]}";
+}
+
+// One row per counter: machine,section,key,value. Memory keys are the first
+// address of each heatSize range; I/O rows are keyed by instruction pointer.
+void
+Profiler::writeCsv(std::ostream& stream) const
+{
+	for (size_t opCode = 0; opCode < m_opCodes.size(); ++opCode)
+	{
+		if (m_opCodes[opCode] != 0)
+		{
+			stream << m_machine << ",opcode," << opCodeName(opCode) << ','
+			       << m_opCodes[opCode] << '\n';
+		}
+	}
+	auto writeCounts = [&](const char* section, const std::vector<uint64_t>& dense,
+	                       const Histogram& sparse, uint64_t scale) {
+		forEachCount(dense, sparse, [&](uint64_t index, uint64_t count) {
+			stream << m_machine << ',' << section << ',' << index * scale << ',' << count
+			       << '\n';
+		});
+	};
+	writeCounts("ip", m_hits, m_sparseHits, 1);
+	writeCounts("read", m_reads, m_sparseReads, heatSize);
+	writeCounts("write", m_writes, m_sparseWrites, heatSize);
+	for (const auto& event : m_ioEvents)
+	{
+		stream << m_machine << ',' << eventName(event.m_event) << ','
+		       << event.m_instructionPointer << ',' << event.m_nanosecondsSincePrevious
+		       << '\n';
+	}
+}
+
+uint64_t
+Profiler::machine() const
+{
+	return m_machine;
+}
+
+uint64_t
+Profiler::executed(uint8_t opCode) const
+{
+	return m_opCodes[opCode];
+}
+
+uint64_t
+Profiler::hits(uint64_t instructionPointer) const
+{
+	if (instructionPointer < m_hits.size())
+	{
+		return m_hits[instructionPointer];
+	}
+	auto it = m_sparseHits.find(instructionPointer);
+	return it == m_sparseHits.end() ? 0 : it->second;
+}
+
+const std::vector<Profiler::IoEvent>&
+Profiler::ioEvents() const
+{
+	return m_ioEvents;
+}
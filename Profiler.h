@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Execution profile of one machine: how often each opcode and each
+// instruction address ran, read and write counts per range of heatSize
+// words, and the wall time between consecutive I/O events. Built into
+// Runtime when the library is compiled with INTCODE_PROFILE; each machine
+// appends its profile to INTCODE_PROFILE_OUTPUT (default
+// intcode-profile.json) when it halts, as one JSON object per line, or as
+// CSV rows if the file name ends in ".csv".
+//
+// Runtime keeps a Counter beside each decoded instruction and block, so the
+// hot loop pays one increment per instruction or block; the counts, and the
+// memory traffic of the operands they imply, are folded into the profile
+// when the code is invalidated or the profile is read. A relative-mode
+// operand's address depends on the relative base, so each Counter also
+// holds the range of bases over which every such operand stays within one
+// heatSize range; the counts are folded early when the base leaves it. On
+// Day9 part 2, whose operands are mostly relative, that happens for fewer
+// than one instruction in a hundred; an optimised build runs it about 4%
+// slower with profiling on the Switch engine and 5-9% on the others.
+class Profiler
+{
+public:
+	static constexpr bool     enabled  = true;
+	static constexpr int      heatBits = 6;
+	static constexpr uint64_t heatSize = uint64_t{1} << heatBits;
+
+	struct Counter
+	{
+		uint64_t m_count{};
+		// The counted code's relative-mode operands fall in the same heat
+		// ranges for the m_baseSpan relative bases from m_firstBase on,
+		// wrapping around. The window starts out empty, so that Runtime can
+		// let holds() stand in for its check that the code is decoded.
+		uint64_t m_firstBase{};
+		uint64_t m_baseSpan{};
+
+		void
+		operator++()
+		{
+			++m_count;
+		}
+
+		bool
+		holds(uint64_t relativeBase) const
+		{
+			return relativeBase - m_firstBase < m_baseSpan;
+		}
+
+		// Starts counting afresh at relativeBase, for code without
+		// relative-mode operands until narrow() adds them.
+		void
+		restart(uint64_t relativeBase)
+		{
+			m_count     = 0;
+			m_firstBase = relativeBase;
+			m_baseSpan  = ~uint64_t{0};
+		}
+
+		void
+		clear()
+		{
+			m_count    = 0;
+			m_baseSpan = 0;
+		}
+
+		// Narrows the bases held to those that keep the operand at offset
+		// from relativeBase, which must be held, in its current heat range.
+		void
+		narrow(uint64_t relativeBase, uint64_t offset)
+		{
+			uint64_t below = (relativeBase + offset) % heatSize;
+			uint64_t above = heatSize - 1 - below;
+			if (m_baseSpan != ~uint64_t{0})
+			{
+				below = std::min(below, relativeBase - m_firstBase);
+				above = std::min(above, m_firstBase + m_baseSpan - 1 - relativeBase);
+			}
+			m_firstBase = relativeBase - below;
+			m_baseSpan  = below + above + 1;
+		}
+	};
+
+	enum class Event : uint8_t
+	{
+		Input,
+		Output
+	};
+
+	struct IoEvent
+	{
+		Event    m_event{};
+		uint64_t m_instructionPointer{};
+		int64_t  m_nanosecondsSincePrevious{};
+	};
+
+	Profiler();
+
+	// Negative times take back counts for an instruction that did not
+	// complete, e.g. an Input still waiting for a value.
+	void
+	instruction(uint64_t instructionPointer, uint8_t opCode, int64_t times = 1)
+	{
+		m_opCodes[opCode] += times;
+		count(m_hits, m_sparseHits, instructionPointer, times);
+	}
+
+	void
+	read(uint64_t address, int64_t times = 1)
+	{
+		count(m_reads, m_sparseReads, address >> heatBits, times);
+	}
+
+	void
+	write(uint64_t address, int64_t times = 1)
+	{
+		count(m_writes, m_sparseWrites, address >> heatBits, times);
+	}
+
+	void io(Event event, uint64_t instructionPointer);
+	// Appends the profile to the output file.
+	void halted() const;
+
+	void writeJson(std::ostream& stream) const;
+	void writeCsv(std::ostream& stream) const;
+
+	uint64_t                    machine() const;
+	uint64_t                    executed(uint8_t opCode) const;
+	uint64_t                    hits(uint64_t instructionPointer) const;
+	const std::vector<IoEvent>& ioEvents() const;
+
+private:
+	using Clock     = std::chrono::steady_clock;
+	using Histogram = std::unordered_map<uint64_t, uint64_t>;
+
+	// Dense counters cover addresses below this; the rest go to a map.
+	static constexpr uint64_t maxDense = uint64_t{1} << 20;
+
+	static void
+	count(std::vector<uint64_t>& dense, Histogram& sparse, uint64_t index, int64_t times)
+	{
+		if (index < dense.size()) [[likely]]
+		{
+			dense[index] += times;
+			return;
+		}
+		countSlow(dense, sparse, index, times);
+	}
+	static void countSlow(std::vector<uint64_t>& dense, Histogram& sparse, uint64_t index,
+	                      int64_t times);
+
+	template <typename Visit>
+	static void forEachCount(const std::vector<uint64_t>& dense, const Histogram& sparse,
+	                         Visit visit);
+
+	uint64_t                  m_machine{};
+	std::array<uint64_t, 256> m_opCodes{};
+	std::vector<uint64_t>     m_hits;
+	Histogram                 m_sparseHits;
+	std::vector<uint64_t>     m_reads;
+	Histogram                 m_sparseReads;
+	std::vector<uint64_t>     m_writes;
+	Histogram                 m_sparseWrites;
+	std::vector<IoEvent>      m_ioEvents;
+	Clock::time_point         m_lastIo;
+};
+
+// Stand-in with the same hooks when profiling is compiled out; every call
+// inlines to nothing.
+class NullProfiler
+{
+public:
+	static constexpr bool enabled = false;
+
+	struct Counter
+	{
+		void operator++() {}
+	};
+
+	void instruction(uint64_t, uint8_t, int64_t = 1) {}
+	void read(uint64_t, int64_t = 1) {}
+	void write(uint64_t, int64_t = 1) {}
+	void io(Profiler::Event, uint64_t) {}
+	void halted() const {}
+};
+
+#if defined(INTCODE_PROFILE)
+using RuntimeProfiler = Profiler;
+#else
+using RuntimeProfiler = NullProfiler;
+#endif
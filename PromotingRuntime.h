@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Intcode.h"
+
+#include <algorithm>
+#include <optional>
+#include <type_traits>
+#include <variant>
+
+// Runs a program in the narrowest word type that holds it: 32-bit words
+// until a result overflows, then 64-bit, then 128-bit. Each step promotes
+// the machine in place and re-executes the overflowing instruction, so the
+// host sees one machine with exact arithmetic. Only an overflow of 128 bits
+// is reported, as State::Overflowed.
+class PromotingRuntime
+{
+public:
+	using State  = RuntimeBase::State;
+	using Engine = RuntimeBase::Engine;
+
+	PromotingRuntime(const Program& program, Engine engine = Engine::Switch)
+	    : m_machine(start(program, engine))
+	{
+	}
+
+	void
+	run()
+	{
+		for (;;)
+		{
+			std::visit([](auto& machine) { machine.run(); }, m_machine);
+			if (state() != State::Overflowed || !promote())
+			{
+				return;
+			}
+		}
+	}
+
+	State
+	state() const
+	{
+		return std::visit([](const auto& machine) { return machine.state(); }, m_machine);
+	}
+
+	bool
+	isHalted() const
+	{
+		return state() == State::Halted;
+	}
+
+	// Bits per word of the machine as currently promoted.
+	int
+	wordBits() const
+	{
+		return std::visit(
+		    [](const auto& machine) {
+			    return static_cast<int>(8 * sizeof(typename std::decay_t<decltype(machine)>::Value));
+		    },
+		    m_machine);
+	}
+
+	// Promotes first if the value does not fit the current word.
+	void
+	addInput(WideValue value)
+	{
+		while (!std::visit(
+		    [&](auto& machine) {
+			    using Word = typename std::decay_t<decltype(machine)>::Value;
+			    if (static_cast<Word>(value) != value)
+			    {
+				    return false;
+			    }
+			    machine.addInput(static_cast<Word>(value));
+			    return true;
+		    },
+		    m_machine))
+		{
+			promote();
+		}
+	}
+
+	std::optional<WideValue>
+	getOutput()
+	{
+		return std::visit(
+		    [](auto& machine) -> std::optional<WideValue> {
+			    if (auto value = machine.getOutput())
+			    {
+				    return *value;
+			    }
+			    return {};
+		    },
+		    m_machine);
+	}
+
+private:
+	using Narrow = BasicRuntime<int32_t, true>;
+	using Medium = BasicRuntime<ProgramValue, true>;
+	using Wide   = BasicRuntime<WideValue, true>;
+
+	using Machine = std::variant<Narrow, Medium, Wide>;
+
+	static Machine
+	start(const Program& program, Engine engine)
+	{
+		bool narrow = std::all_of(program.begin(), program.end(), [](ProgramValue value) {
+			return static_cast<int32_t>(value) == value;
+		});
+		if (narrow)
+		{
+			return Machine(std::in_place_type<Narrow>, program, engine);
+		}
+		return Machine(std::in_place_type<Medium>, program, engine);
+	}
+
+	// Returns false if the machine already uses the widest word.
+	bool
+	promote()
+	{
+		if (auto* machine = std::get_if<Narrow>(&m_machine))
+		{
+			Medium promoted = machine->promote<ProgramValue>();
+			m_machine.emplace<Medium>(std::move(promoted));
+			return true;
+		}
+		if (auto* machine = std::get_if<Medium>(&m_machine))
+		{
+			Wide promoted = machine->promote<WideValue>();
+			m_machine.emplace<Wide>(std::move(promoted));
+			return true;
+		}
+		return false;
+	}
+
+	Machine m_machine;
+};
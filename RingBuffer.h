@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+// Growable FIFO with O(1) push and pop. Capacity is kept a power of two so
+// positions wrap with a mask; head and tail only ever increase.
+template <typename T>
+class RingBuffer
+{
+public:
+	bool
+	empty() const
+	{
+		return m_head == m_tail;
+	}
+
+	size_t
+	size() const
+	{
+		return m_tail - m_head;
+	}
+
+	const T&
+	front() const
+	{
+		return m_buffer[m_head & mask()];
+	}
+
+	const T&
+	operator[](size_t index) const
+	{
+		return m_buffer[(m_head + index) & mask()];
+	}
+
+	void
+	push(const T& value)
+	{
+		reserve(size() + 1);
+		m_buffer[m_tail++ & mask()] = value;
+	}
+
+	template <typename Iterator>
+	void
+	push(Iterator first, Iterator last)
+	{
+		reserve(size() + std::distance(first, last));
+		for (; first != last; ++first)
+		{
+			m_buffer[m_tail++ & mask()] = *first;
+		}
+	}
+
+	T
+	pop()
+	{
+		return m_buffer[m_head++ & mask()];
+	}
+
+	// Moves up to count values into out, in at most two contiguous copies.
+	size_t
+	pop(T* out, size_t count)
+	{
+		count        = std::min(count, size());
+		size_t start = m_head & mask();
+		size_t first = std::min(count, m_buffer.size() - start);
+		std::copy_n(m_buffer.begin() + start, first, out);
+		std::copy_n(m_buffer.begin(), count - first, out + first);
+		m_head += count;
+		return count;
+	}
+
+	void
+	clear()
+	{
+		m_head = m_tail = 0;
+	}
+
+	void
+	reserve(size_t capacity)
+	{
+		if (capacity <= m_buffer.size())
+		{
+			return;
+		}
+		size_t newCapacity = std::max<size_t>(m_buffer.size(), 16);
+		while (newCapacity < capacity)
+		{
+			newCapacity *= 2;
+		}
+		std::vector<T> buffer(newCapacity);
+		size_t         count = pop(buffer.data(), size());
+		m_head               = 0;
+		m_tail               = count;
+		m_buffer             = std::move(buffer);
+	}
+
+private:
+	size_t
+	mask() const
+	{
+		return m_buffer.size() - 1;
+	}
+
+	std::vector<T> m_buffer;
+	size_t         m_head{};
+	size_t         m_tail{};
+};
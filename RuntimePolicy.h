@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Profiler.h"
+#include "Tracer.h"
+
+#include <cstdint>
+
+// Compile-time choices for a BasicRuntime, so a build only pays for the
+// checks and instrumentation it asks for.
+//
+// Profiler and Tracer are the hooks every machine calls; NullProfiler and
+// NullTracer compile them out. With validate, every instruction is checked
+// before it runs and an unknown opcode, an unknown parameter mode, a store
+// through an immediate parameter, or an address that is negative or above
+// maxAddress throws std::runtime_error naming the instruction, its address
+// and the offending parameter. Without it no check is compiled in: unknown
+// opcodes are skipped, unknown modes read as Position, and memory grows to
+// whatever address the program touches.
+template <typename ProfilerType, typename TracerType, bool Validate,
+          uint64_t MaxAddress = (uint64_t{1} << 32) - 1>
+struct RuntimePolicy
+{
+	using Profiler = ProfilerType;
+	using Tracer   = TracerType;
+
+	static constexpr bool     validate   = Validate;
+	static constexpr uint64_t maxAddress = MaxAddress;
+};
+
+// What Runtime uses: instrumentation as configured with INTCODE_PROFILE and
+// INTCODE_TRACE, and checks with INTCODE_VALIDATE.
+#if defined(INTCODE_VALIDATE)
+struct DefaultPolicy : RuntimePolicy<RuntimeProfiler, RuntimeTracer, true>
+{
+};
+#else
+struct DefaultPolicy : RuntimePolicy<RuntimeProfiler, RuntimeTracer, false>
+{
+};
+#endif
+
+// For programs known to be well formed: a bare dispatch loop whatever the
+// build configuration. Distinct types, so each policy is its own
+// instantiation even where the configuration makes them agree.
+struct TrustedPolicy : RuntimePolicy<NullProfiler, NullTracer, false>
+{
+};
+
+// Traps on anything invalid whatever the build configuration.
+struct DebugPolicy : RuntimePolicy<RuntimeProfiler, RuntimeTracer, true>
+{
+};
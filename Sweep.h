@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <latch>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Parallel searches over an indexed candidate space [0, count). The
+// generator maps an index to a candidate and the evaluation runs on pool
+// workers in chunks. Results only depend on candidate order, never on how
+// the work was scheduled, so they match a sequential loop over the indices.
+// The calling thread blocks until the sweep is done, so a sweep must not be
+// started from one of the pool's own workers.
+namespace sweep
+{
+namespace detail
+{
+template <typename Body>
+void
+forEachChunk(WorkStealingPool& pool, size_t count, Body body)
+{
+	size_t     chunks    = std::min(count, pool.size() * 8);
+	size_t     chunkSize = chunks ? (count + chunks - 1) / chunks : 0;
+	chunks               = chunkSize ? (count + chunkSize - 1) / chunkSize : 0;
+	std::latch done(static_cast<std::ptrdiff_t>(chunks));
+	for (size_t chunk = 0; chunk < chunks; ++chunk)
+	{
+		pool.submit([&, chunk] {
+			size_t begin = chunk * chunkSize;
+			body(chunk, begin, std::min(count, begin + chunkSize));
+			done.count_down();
+		});
+	}
+	done.wait();
+}
+} // namespace detail
+
+// Returns the lowest-indexed candidate satisfying the predicate. Once a match
+// is found, workers skip every candidate after it.
+template <typename Generate, typename Predicate>
+auto
+firstMatch(WorkStealingPool& pool, size_t count, Generate generate,
+           Predicate matches) -> std::optional<decltype(generate(size_t{}))>
+{
+	std::atomic<size_t> found{count};
+	detail::forEachChunk(pool, count, [&](size_t, size_t begin, size_t end) {
+		for (size_t index = begin; index < end && index < found.load(); ++index)
+		{
+			if (matches(generate(index)))
+			{
+				size_t current = found.load();
+				while (index < current && !found.compare_exchange_weak(current, index))
+				{
+				}
+				return;
+			}
+		}
+	});
+	if (found.load() == count)
+	{
+		return {};
+	}
+	return generate(found.load());
+}
+
+// Returns the candidate with the highest score and that score. Ties go to the
+// highest index, as with a sequential `score >= best` scan.
+template <typename Generate, typename Evaluate>
+auto
+argMax(WorkStealingPool& pool, size_t count, Generate generate, Evaluate evaluate)
+    -> std::optional<std::pair<decltype(generate(size_t{})),
+                               decltype(evaluate(generate(size_t{})))>>
+{
+	using Score = decltype(evaluate(generate(size_t{})));
+	std::vector<std::optional<std::pair<Score, size_t>>> best(pool.size() * 8);
+	detail::forEachChunk(pool, count, [&](size_t chunk, size_t begin, size_t end) {
+		for (size_t index = begin; index < end; ++index)
+		{
+			Score score = evaluate(generate(index));
+			if (!best[chunk] || score >= best[chunk]->first)
+			{
+				best[chunk] = std::make_pair(score, index);
+			}
+		}
+	});
+	std::optional<std::pair<Score, size_t>> overall;
+	for (const auto& chunkBest : best)
+	{
+		if (chunkBest && (!overall || chunkBest->first >= overall->first))
+		{
+			overall = chunkBest;
+		}
+	}
+	if (!overall)
+	{
+		return {};
+	}
+	return std::make_pair(generate(overall->second), overall->first);
+}
+} // namespace sweep
@@ -0,0 +1,462 @@
+#include "Symbolic.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+// Past these a value is treated as opaque rather than tracked.
+constexpr size_t maxTerms  = 256;
+constexpr int    maxDegree = 64;
+
+ProgramValue
+wrappingAdd(ProgramValue lhs, ProgramValue rhs)
+{
+	return static_cast<ProgramValue>(static_cast<uint64_t>(lhs) + static_cast<uint64_t>(rhs));
+}
+
+ProgramValue
+wrappingMult(ProgramValue lhs, ProgramValue rhs)
+{
+	return static_cast<ProgramValue>(static_cast<uint64_t>(lhs) * static_cast<uint64_t>(rhs));
+}
+
+void
+trim(Polynomial::Monomial& monomial)
+{
+	while (!monomial.empty() && monomial.back() == 0)
+	{
+		monomial.pop_back();
+	}
+}
+
+void
+accumulate(std::map<Polynomial::Monomial, ProgramValue>& terms,
+           const Polynomial::Monomial& monomial, ProgramValue coefficient)
+{
+	auto [it, inserted] = terms.try_emplace(monomial, coefficient);
+	if (!inserted)
+	{
+		it->second = wrappingAdd(it->second, coefficient);
+	}
+	if (it->second == 0)
+	{
+		terms.erase(it);
+	}
+}
+
+// Unknown words are opaque; a word held by the image or written from
+// constants is a constant polynomial.
+using Value = std::optional<Polynomial>;
+
+class SymbolicMemory
+{
+public:
+	SymbolicMemory(const Program& program, std::span<const ProgramValue> variables)
+	    : m_words(program.begin(), program.end())
+	{
+		for (size_t i = 0; i < variables.size(); ++i)
+		{
+			write(variables[i], Polynomial::variable(i));
+		}
+	}
+
+	Value
+	read(ProgramValue address) const
+	{
+		if (address < 0)
+		{
+			return {};
+		}
+		if (static_cast<size_t>(address) < m_words.size())
+		{
+			return m_words[address];
+		}
+		auto it = m_beyond.find(address);
+		return it != m_beyond.end() ? it->second : Value(Polynomial());
+	}
+
+	void
+	write(ProgramValue address, Value value)
+	{
+		if (static_cast<size_t>(address) < m_words.size())
+		{
+			m_words[address] = std::move(value);
+		}
+		else
+		{
+			m_beyond[address] = std::move(value);
+		}
+	}
+
+private:
+	std::vector<Value>            m_words;
+	std::map<ProgramValue, Value> m_beyond;
+};
+
+Value
+bounded(Polynomial polynomial)
+{
+	if (polynomial.numTerms() > maxTerms || polynomial.totalDegree() > maxDegree)
+	{
+		return {};
+	}
+	return polynomial;
+}
+
+std::optional<ProgramValue>
+constantOf(const Value& value)
+{
+	if (!value || !value->isConstant())
+	{
+		return {};
+	}
+	return value->constant();
+}
+
+bool
+solveFrom(const Polynomial& polynomial, ProgramValue target, std::span<const ProgramValue> domains,
+          size_t variable, std::vector<ProgramValue>& assignment)
+{
+	if (variable == domains.size())
+	{
+		return polynomial.isConstant() && polynomial.constant() == target;
+	}
+	ProgramValue domain = domains[variable];
+	if (variable + 1 < domains.size())
+	{
+		for (ProgramValue value = 0; value < domain; ++value)
+		{
+			assignment[variable] = value;
+			if (solveFrom(polynomial.substitute(variable, value), target, domains, variable + 1,
+			              assignment))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Only the last variable is left: a + b * x. If neither end of the
+	// domain overflows, no value in between does, and integer division
+	// finds the only candidate.
+	ProgramValue a = polynomial.substitute(variable, 0).constant();
+	ProgramValue b =
+	    wrappingAdd(polynomial.substitute(variable, 1).constant(), wrappingMult(a, -1));
+	ProgramValue last{};
+	ProgramValue difference{};
+	if (domain > 0 && polynomial.degree(variable) <= 1 &&
+	    !__builtin_mul_overflow(b, domain - 1, &last) && !__builtin_add_overflow(a, last, &last) &&
+	    !__builtin_sub_overflow(target, a, &difference))
+	{
+		if (b == 0)
+		{
+			assignment[variable] = 0;
+			return a == target;
+		}
+		WideValue value = WideValue(difference) / b;
+		if (WideValue(difference) % b != 0 || value < 0 || value >= domain)
+		{
+			return false;
+		}
+		assignment[variable] = static_cast<ProgramValue>(value);
+		return true;
+	}
+	for (ProgramValue value = 0; value < domain; ++value)
+	{
+		assignment[variable] = value;
+		if (polynomial.evaluate(assignment) == target)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+} // namespace
+
+Polynomial::Polynomial(ProgramValue constant)
+{
+	if (constant != 0)
+	{
+		m_terms.emplace(Monomial{}, constant);
+	}
+}
+
+Polynomial
+Polynomial::variable(size_t index)
+{
+	Polynomial ret;
+	Monomial   monomial(index + 1);
+	monomial[index] = 1;
+	ret.m_terms.emplace(std::move(monomial), 1);
+	return ret;
+}
+
+bool
+Polynomial::isConstant() const
+{
+	return m_terms.empty() || (m_terms.size() == 1 && m_terms.begin()->first.empty());
+}
+
+ProgramValue
+Polynomial::constant() const
+{
+	auto it = m_terms.find(Monomial{});
+	return it != m_terms.end() ? it->second : 0;
+}
+
+int
+Polynomial::degree(size_t variable) const
+{
+	int ret = 0;
+	for (const auto& [monomial, coefficient] : m_terms)
+	{
+		if (variable < monomial.size())
+		{
+			ret = std::max<int>(ret, monomial[variable]);
+		}
+	}
+	return ret;
+}
+
+int
+Polynomial::totalDegree() const
+{
+	int ret = 0;
+	for (const auto& [monomial, coefficient] : m_terms)
+	{
+		int degree = 0;
+		for (uint16_t exponent : monomial)
+		{
+			degree += exponent;
+		}
+		ret = std::max(ret, degree);
+	}
+	return ret;
+}
+
+size_t
+Polynomial::numTerms() const
+{
+	return m_terms.size();
+}
+
+ProgramValue
+Polynomial::evaluate(std::span<const ProgramValue> values) const
+{
+	ProgramValue ret = 0;
+	for (const auto& [monomial, coefficient] : m_terms)
+	{
+		if (monomial.size() > values.size())
+		{
+			throw std::invalid_argument("Polynomial::evaluate: missing variable value");
+		}
+		ProgramValue term = coefficient;
+		for (size_t i = 0; i < monomial.size(); ++i)
+		{
+			for (uint16_t j = 0; j < monomial[i]; ++j)
+			{
+				term = wrappingMult(term, values[i]);
+			}
+		}
+		ret = wrappingAdd(ret, term);
+	}
+	return ret;
+}
+
+Polynomial
+Polynomial::substitute(size_t variable, ProgramValue value) const
+{
+	Polynomial ret;
+	for (const auto& [monomial, coefficient] : m_terms)
+	{
+		if (variable >= monomial.size() || monomial[variable] == 0)
+		{
+			accumulate(ret.m_terms, monomial, coefficient);
+			continue;
+		}
+		ProgramValue term = coefficient;
+		for (uint16_t j = 0; j < monomial[variable]; ++j)
+		{
+			term = wrappingMult(term, value);
+		}
+		Monomial rest  = monomial;
+		rest[variable] = 0;
+		trim(rest);
+		accumulate(ret.m_terms, rest, term);
+	}
+	return ret;
+}
+
+const std::map<Polynomial::Monomial, ProgramValue>&
+Polynomial::terms() const
+{
+	return m_terms;
+}
+
+Polynomial
+operator+(const Polynomial& lhs, const Polynomial& rhs)
+{
+	Polynomial ret = lhs;
+	for (const auto& [monomial, coefficient] : rhs.m_terms)
+	{
+		accumulate(ret.m_terms, monomial, coefficient);
+	}
+	return ret;
+}
+
+Polynomial
+operator*(const Polynomial& lhs, const Polynomial& rhs)
+{
+	Polynomial ret;
+	for (const auto& [left, leftCoefficient] : lhs.m_terms)
+	{
+		for (const auto& [right, rightCoefficient] : rhs.m_terms)
+		{
+			Polynomial::Monomial monomial(std::max(left.size(), right.size()));
+			for (size_t i = 0; i < monomial.size(); ++i)
+			{
+				monomial[i] = (i < left.size() ? left[i] : 0) + (i < right.size() ? right[i] : 0);
+			}
+			accumulate(ret.m_terms, monomial, wrappingMult(leftCoefficient, rightCoefficient));
+		}
+	}
+	return ret;
+}
+
+std::ostream&
+operator<<(std::ostream& ostream, const Polynomial& polynomial)
+{
+	if (polynomial.terms().empty())
+	{
+		return ostream << 0;
+	}
+	bool first = true;
+	// Highest powers of x0 first, the constant last.
+	for (auto it = polynomial.terms().rbegin(); it != polynomial.terms().rend(); ++it)
+	{
+		const auto& [monomial, coefficient] = *it;
+		unsigned long long magnitude =
+		    coefficient < 0 ? 0 - static_cast<unsigned long long>(coefficient) : coefficient;
+		if (first)
+		{
+			ostream << (coefficient < 0 ? "-" : "");
+		}
+		else
+		{
+			ostream << (coefficient < 0 ? " - " : " + ");
+		}
+		first = false;
+
+		const char* separator = "";
+		if (magnitude != 1 || monomial.empty())
+		{
+			ostream << magnitude;
+			separator = "*";
+		}
+		for (size_t i = 0; i < monomial.size(); ++i)
+		{
+			if (monomial[i] == 0)
+			{
+				continue;
+			}
+			ostream << separator << 'x' << i;
+			if (monomial[i] > 1)
+			{
+				ostream << '^' << monomial[i];
+			}
+			separator = "*";
+		}
+	}
+	return ostream;
+}
+
+std::optional<std::vector<Polynomial>>
+evaluateSymbolically(const Program& program, std::span<const ProgramValue> variables,
+                     std::span<const ProgramValue> results)
+{
+	SymbolicMemory memory(program, variables);
+
+	// Without jumps the instruction pointer only moves forward, and the
+	// words past the image are zero, which is not an opcode; so this ends.
+	ProgramValue instructionPointer = 0;
+	for (;;)
+	{
+		std::optional<ProgramValue> word = constantOf(memory.read(instructionPointer));
+		if (!word || *word < 0)
+		{
+			return {};
+		}
+		OpCode opCode = static_cast<OpCode>(*word % 100);
+		if (opCode == OpCode::Halt)
+		{
+			break;
+		}
+		if (opCode != OpCode::Add && opCode != OpCode::Mult)
+		{
+			return {};
+		}
+
+		// With no NudgeRelativeBase the relative base stays 0, so every
+		// mode but Value addresses memory directly.
+		Value        operands[2];
+		ProgramValue modes = *word / 100;
+		for (int i = 0; i < 2; ++i, modes /= 10)
+		{
+			Value parameter = memory.read(instructionPointer + 1 + i);
+			if (static_cast<ParameterMode>(modes % 10) == ParameterMode::Value)
+			{
+				operands[i] = std::move(parameter);
+			}
+			else if (std::optional<ProgramValue> address = constantOf(parameter))
+			{
+				operands[i] = memory.read(*address);
+			}
+		}
+		std::optional<ProgramValue> target = constantOf(memory.read(instructionPointer + 3));
+		if (!target || *target < 0)
+		{
+			return {};
+		}
+
+		Value result;
+		if (operands[0] && operands[1])
+		{
+			result = bounded(opCode == OpCode::Add ? *operands[0] + *operands[1]
+			                                       : *operands[0] * *operands[1]);
+		}
+		memory.write(*target, std::move(result));
+		instructionPointer += 4;
+	}
+
+	std::vector<Polynomial> ret;
+	for (ProgramValue address : results)
+	{
+		Value value = memory.read(address);
+		if (!value)
+		{
+			return {};
+		}
+		ret.push_back(std::move(*value));
+	}
+	return ret;
+}
+
+std::optional<std::vector<ProgramValue>>
+solve(const Polynomial& polynomial, ProgramValue target, std::span<const ProgramValue> domains)
+{
+	for (const auto& [monomial, coefficient] : polynomial.terms())
+	{
+		if (monomial.size() > domains.size())
+		{
+			throw std::invalid_argument("solve: a variable has no domain");
+		}
+	}
+	std::vector<ProgramValue> assignment(domains.size());
+	if (!solveFrom(polynomial, target, domains, 0, assignment))
+	{
+		return {};
+	}
+	return assignment;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Intcode.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+// A polynomial in variables x0, x1, ... whose coefficients wrap at 64 bits
+// like the words of an unchecked Runtime, so evaluating it at concrete
+// values gives the same word as running the program on them.
+class Polynomial
+{
+public:
+	// Exponent of each variable, without trailing zeros.
+	using Monomial = std::vector<uint16_t>;
+
+	Polynomial() = default;
+	Polynomial(ProgramValue constant);
+
+	static Polynomial variable(size_t index);
+
+	bool         isConstant() const;
+	// The coefficient of the term without variables.
+	ProgramValue constant() const;
+	int          degree(size_t variable) const;
+	int          totalDegree() const;
+	size_t       numTerms() const;
+	// values must hold one value for every variable the polynomial uses.
+	ProgramValue evaluate(std::span<const ProgramValue> values) const;
+	Polynomial   substitute(size_t variable, ProgramValue value) const;
+
+	const std::map<Monomial, ProgramValue>& terms() const;
+
+	friend Polynomial operator+(const Polynomial& lhs, const Polynomial& rhs);
+	friend Polynomial operator*(const Polynomial& lhs, const Polynomial& rhs);
+
+	bool operator==(const Polynomial&) const = default;
+
+private:
+	// No zero coefficients.
+	std::map<Monomial, ProgramValue> m_terms;
+};
+
+std::ostream& operator<<(std::ostream& ostream, const Polynomial& polynomial);
+
+// Runs a straight-line program of Add and Mult instructions from address 0
+// up to Halt with the words at the variables' addresses unknown (x0, x1,
+// ...), and returns the polynomials the words at results hold on halt.
+// Reading through an address that depends on a variable gives an opaque
+// value, which is fine as long as no result depends on it. Returns nothing
+// when the program leaves that model: any other opcode, an opcode word or
+// store address that depends on a variable, a result that is opaque, or a
+// polynomial too large to track. Callers then run the program concretely.
+std::optional<std::vector<Polynomial>> evaluateSymbolically(const Program&               program,
+                                                            std::span<const ProgramValue> variables,
+                                                            std::span<const ProgramValue> results);
+
+// The first assignment, in lexicographic order, with variable i in
+// [0, domains[i]) for which the polynomial equals target. The last variable
+// is solved for directly where the polynomial is linear in it and cannot
+// wrap over its domain, so two variables cost one pass over the first.
+std::optional<std::vector<ProgramValue>> solve(const Polynomial& polynomial, ProgramValue target,
+                                               std::span<const ProgramValue> domains);
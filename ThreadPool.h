@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each owning a deque of tasks. A worker takes
+// its own newest task first and, when it runs dry, steals the oldest task
+// from another worker. Tasks submitted from a worker go onto that worker's
+// own deque; tasks from other threads are spread round-robin. Idle workers
+// sleep on a condition variable instead of spinning.
+class WorkStealingPool
+{
+public:
+	using Task = std::function<void()>;
+
+	explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency())
+	{
+		threads = std::max<size_t>(threads, 1);
+		for (size_t i = 0; i < threads; ++i)
+		{
+			m_workers.push_back(std::make_unique<Worker>());
+		}
+		for (size_t i = 0; i < threads; ++i)
+		{
+			m_threads.emplace_back([this, i] { workerLoop(i); });
+		}
+	}
+
+	~WorkStealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		for (auto& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	size_t
+	size() const
+	{
+		return m_workers.size();
+	}
+
+	void
+	submit(Task task)
+	{
+		size_t index = (currentPool() == this)
+		                   ? currentWorker()
+		                   : m_nextWorker.fetch_add(1) % m_workers.size();
+		{
+			std::lock_guard<std::mutex> lock(m_workers[index]->m_mutex);
+			m_workers[index]->m_tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			++m_queued;
+		}
+		m_wake.notify_one();
+	}
+
+private:
+	struct Worker
+	{
+		std::mutex       m_mutex;
+		std::deque<Task> m_tasks;
+	};
+
+	static const WorkStealingPool*&
+	currentPool()
+	{
+		thread_local const WorkStealingPool* pool = nullptr;
+		return pool;
+	}
+
+	static size_t&
+	currentWorker()
+	{
+		thread_local size_t worker = 0;
+		return worker;
+	}
+
+	bool
+	tryPop(size_t index, Task& task)
+	{
+		for (size_t i = 0; i < m_workers.size(); ++i)
+		{
+			Worker&                     worker = *m_workers[(index + i) % m_workers.size()];
+			std::lock_guard<std::mutex> lock(worker.m_mutex);
+			if (worker.m_tasks.empty())
+			{
+				continue;
+			}
+			if (i == 0)
+			{
+				task = std::move(worker.m_tasks.back());
+				worker.m_tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(worker.m_tasks.front());
+				worker.m_tasks.pop_front();
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void
+	workerLoop(size_t index)
+	{
+		currentPool()   = this;
+		currentWorker() = index;
+		for (;;)
+		{
+			Task task;
+			if (tryPop(index, task))
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_sleepMutex);
+					--m_queued;
+				}
+				task();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_wake.wait(lock, [this] { return m_stopping || m_queued > 0; });
+			if (m_stopping && m_queued == 0)
+			{
+				return;
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread>             m_threads;
+	std::atomic<size_t>                  m_nextWorker{0};
+	std::mutex                           m_sleepMutex;
+	std::condition_variable              m_wake;
+	size_t                               m_queued{0};
+	bool                                 m_stopping{false};
+};
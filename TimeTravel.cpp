@@ -0,0 +1,216 @@
+#include "TimeTravel.h"
+
+#include <algorithm>
+
+namespace
+{
+// Lets decodeInstruction() read through the machine.
+struct MachineMemory
+{
+	const Runtime& m_machine;
+
+	ProgramValue
+	operator[](ProgramValue address) const
+	{
+		return m_machine.read(address);
+	}
+};
+} // namespace
+
+TimeTravel::TimeTravel(const Program& program, TimeTravelOptions options)
+    : m_options(options)
+    , m_machine(program)
+{
+	m_options.m_snapshotInterval = std::max<uint64_t>(m_options.m_snapshotInterval, 1);
+	m_options.m_maxSnapshots     = std::max<size_t>(m_options.m_maxSnapshots, 2);
+	m_snapshots.push_back(Snapshot{0, 0, 0, m_machine.fork()});
+}
+
+void
+TimeTravel::addInput(ProgramValue value)
+{
+	m_inputLog.push_back(value);
+}
+
+TimeTravel::State
+TimeTravel::run(uint64_t count)
+{
+	State state = m_machine.state();
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		state = step();
+		if (state != State::Running)
+		{
+			break;
+		}
+	}
+	return state;
+}
+
+// Notes what the instruction is about to overwrite before running it.
+TimeTravel::State
+TimeTravel::step()
+{
+	if (m_machine.isHalted())
+	{
+		return State::Halted;
+	}
+	Undo        entry{m_machine.instructionPointer(), m_machine.relativeBase()};
+	Instruction instruction =
+	    decodeInstruction(MachineMemory{m_machine}, entry.m_instructionPointer);
+	entry.m_input = instruction.m_opCode == OpCode::Input;
+	if (entry.m_input && m_inputs < m_inputLog.size())
+	{
+		m_machine.addInput(m_inputLog[m_inputs]);
+	}
+	for (int i = 0; i < instruction.m_numParameters; ++i)
+	{
+		if (writesParameter(instruction.m_opCode, i))
+		{
+			const Parameter& parameter = instruction.m_parameters[i];
+			entry.m_wrote              = true;
+			entry.m_address            = parameter.m_value;
+			if (parameter.m_mode == ParameterMode::RelativePosition)
+			{
+				entry.m_address += entry.m_relativeBase;
+			}
+			entry.m_previous = m_machine.read(entry.m_address);
+		}
+	}
+
+	State state = m_machine.step();
+	if (state == State::AwaitingInput)
+	{
+		// Nothing ran.
+		return state;
+	}
+	m_inputs += entry.m_input;
+	if (auto output = m_machine.getOutput())
+	{
+		// A replay produces the outputs already logged.
+		if (m_outputs == m_outputLog.size())
+		{
+			m_outputLog.push_back(*output);
+		}
+		++m_outputs;
+		entry.m_output = true;
+	}
+	++m_position;
+	m_undo.push_back(entry);
+	if (m_undo.size() > m_options.m_maxUndo)
+	{
+		m_undo.pop_front();
+	}
+	if (m_position % m_options.m_snapshotInterval == 0 &&
+	    m_position > m_snapshots.back().m_position)
+	{
+		snapshot();
+	}
+	return state;
+}
+
+bool
+TimeTravel::stepBack()
+{
+	if (m_position == 0)
+	{
+		return false;
+	}
+	if (!m_undo.empty())
+	{
+		undo();
+		return true;
+	}
+	return seek(m_position - 1);
+}
+
+bool
+TimeTravel::seek(uint64_t position)
+{
+	if (position < m_position && m_position - position <= m_undo.size())
+	{
+		while (m_position > position)
+		{
+			undo();
+		}
+		return true;
+	}
+
+	auto nearest = std::upper_bound(
+	                   m_snapshots.begin(), m_snapshots.end(), position,
+	                   [](uint64_t lhs, const Snapshot& rhs) { return lhs < rhs.m_position; }) -
+	               1;
+	if (position < m_position || nearest->m_position > m_position)
+	{
+		restore(*nearest);
+	}
+	while (m_position < position && step() == State::Running)
+	{
+	}
+	return m_position == position;
+}
+
+uint64_t
+TimeTravel::position() const
+{
+	return m_position;
+}
+
+TimeTravel::State
+TimeTravel::state() const
+{
+	return m_machine.state();
+}
+
+const Runtime&
+TimeTravel::machine() const
+{
+	return m_machine;
+}
+
+std::span<const ProgramValue>
+TimeTravel::outputs() const
+{
+	return std::span<const ProgramValue>(m_outputLog.data(), m_outputs);
+}
+
+void
+TimeTravel::restore(Snapshot& snapshot)
+{
+	m_machine  = snapshot.m_machine.fork();
+	m_position = snapshot.m_position;
+	m_inputs   = snapshot.m_inputs;
+	m_outputs  = snapshot.m_outputs;
+	m_undo.clear();
+}
+
+// Thins the snapshots out to every other one, doubling the interval, when
+// there are too many. Every multiple of the interval up to the furthest
+// position run so far keeps its snapshot.
+void
+TimeTravel::snapshot()
+{
+	m_snapshots.push_back(Snapshot{m_position, m_inputs, m_outputs, m_machine.fork()});
+	if (m_snapshots.size() > m_options.m_maxSnapshots)
+	{
+		m_options.m_snapshotInterval *= 2;
+		std::erase_if(m_snapshots, [this](const Snapshot& snapshot) {
+			return snapshot.m_position % m_options.m_snapshotInterval != 0;
+		});
+	}
+}
+
+void
+TimeTravel::undo()
+{
+	const Undo& last = m_undo.back();
+	if (last.m_wrote)
+	{
+		m_machine.write(last.m_address, last.m_previous);
+	}
+	m_machine.setRegisters(last.m_instructionPointer, last.m_relativeBase);
+	m_inputs -= last.m_input;
+	m_outputs -= last.m_output;
+	--m_position;
+	m_undo.pop_back();
+}
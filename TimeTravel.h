@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Intcode.h"
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Runs a machine one instruction at a time while recording enough to move
+// back through its execution: an undo log of the registers and the cell
+// each recent instruction overwrote, and forks of the machine taken every
+// snapshot interval. Stepping back within the undo log undoes instructions
+// directly; any other seek restores the nearest snapshot at or before the
+// target and replays at most one interval from it.
+//
+// Execution is a function of the program and the inputs it consumes, so
+// inputs are kept in order and fed to the machine as Input instructions
+// run, and a replay sees the same values as the first run. Outputs are
+// likewise kept, and outputs() only shows those produced before the
+// current position.
+//
+// Memory is bounded: the undo log keeps the last maxUndo instructions, and
+// once there are maxSnapshots snapshots every other one is dropped and the
+// interval doubles, so seeks stay within one interval of replay however
+// long the run. Snapshots share unwritten pages copy-on-write.
+struct TimeTravelOptions
+{
+	uint64_t m_snapshotInterval{uint64_t{1} << 16};
+	size_t   m_maxSnapshots{64};
+	size_t   m_maxUndo{size_t{1} << 16};
+};
+
+class TimeTravel
+{
+public:
+	using State = RuntimeBase::State;
+
+	explicit TimeTravel(const Program& program, TimeTravelOptions options = {});
+
+	void                          addInput(ProgramValue value);
+	// Runs forward until the machine halts or waits for input, or count
+	// instructions have run.
+	State                         run(uint64_t count = std::numeric_limits<uint64_t>::max());
+	State                         step();
+	// Returns false at the start of the run.
+	bool                          stepBack();
+	// Moves to the state after the given number of instructions. Returns
+	// false, having run as far as it could, if the machine halts or waits
+	// for input first.
+	bool                          seek(uint64_t position);
+	// Instructions executed to reach the current state.
+	uint64_t                      position() const;
+	State                         state() const;
+	// For inspecting registers and memory; changing it is not recorded.
+	const Runtime&                machine() const;
+	std::span<const ProgramValue> outputs() const;
+
+private:
+	struct Undo
+	{
+		ProgramValue m_instructionPointer{};
+		ProgramValue m_relativeBase{};
+		ProgramValue m_address{};
+		ProgramValue m_previous{};
+		bool         m_wrote{};
+		bool         m_input{};
+		bool         m_output{};
+	};
+
+	struct Snapshot
+	{
+		uint64_t m_position{};
+		size_t   m_inputs{};
+		size_t   m_outputs{};
+		Runtime  m_machine;
+	};
+
+	void restore(Snapshot& snapshot);
+	void snapshot();
+	void undo();
+
+	TimeTravelOptions         m_options;
+	Runtime                   m_machine;
+	uint64_t                  m_position{};
+	// Inputs consumed and outputs produced up to the current position.
+	size_t                    m_inputs{};
+	size_t                    m_outputs{};
+	std::vector<ProgramValue> m_inputLog;
+	std::vector<ProgramValue> m_outputLog;
+	std::deque<Undo>          m_undo;
+	// By position; the first is where the recorded history starts.
+	std::vector<Snapshot>     m_snapshots;
+};
@@ -0,0 +1,281 @@
+#include "Tracer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+
+// File layout, all integers little-endian: "ICTR", version, encoding, a
+// 32-bit chunk count, then each chunk as a 32-bit length and its bytes.
+//
+// Record layout: opcode byte; flags byte (parameter count in bits 0-1, bit
+// 2 set if a value was written); parameter modes as a varint, four bits
+// each; then the instruction pointer, parameters, operands and written
+// value, as zigzag varints (Delta) or 8-byte fields (Fixed).
+namespace
+{
+constexpr char    magic[4] = {'I', 'C', 'T', 'R'};
+constexpr uint8_t version  = 1;
+
+class Encoder
+{
+public:
+	Encoder(std::vector<uint8_t>& bytes, Tracer::Encoding encoding)
+	    : m_bytes(bytes)
+	    , m_encoding(encoding)
+	{
+	}
+
+	void
+	byte(uint8_t value)
+	{
+		m_bytes.push_back(value);
+	}
+
+	void
+	varint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			m_bytes.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		m_bytes.push_back(static_cast<uint8_t>(value));
+	}
+
+	void
+	value(int64_t value)
+	{
+		if (m_encoding == Tracer::Encoding::Delta)
+		{
+			varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+			return;
+		}
+		for (int i = 0; i < 8; ++i)
+		{
+			m_bytes.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+		}
+	}
+
+private:
+	std::vector<uint8_t>& m_bytes;
+	Tracer::Encoding      m_encoding;
+};
+
+class Decoder
+{
+public:
+	Decoder(const std::vector<uint8_t>& bytes, Tracer::Encoding encoding)
+	    : m_bytes(bytes)
+	    , m_encoding(encoding)
+	{
+	}
+
+	bool
+	done() const
+	{
+		return m_position == m_bytes.size();
+	}
+
+	uint8_t
+	byte()
+	{
+		if (done())
+		{
+			throw std::runtime_error("trace: truncated record");
+		}
+		return m_bytes[m_position++];
+	}
+
+	uint64_t
+	varint()
+	{
+		uint64_t result = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t next = byte();
+			result |= static_cast<uint64_t>(next & 0x7f) << shift;
+			if (!(next & 0x80))
+			{
+				return result;
+			}
+		}
+		throw std::runtime_error("trace: malformed varint");
+	}
+
+	int64_t
+	value()
+	{
+		if (m_encoding == Tracer::Encoding::Delta)
+		{
+			uint64_t zigzag = varint();
+			return static_cast<int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+		}
+		uint64_t result = 0;
+		for (int i = 0; i < 8; ++i)
+		{
+			result |= static_cast<uint64_t>(byte()) << (8 * i);
+		}
+		return static_cast<int64_t>(result);
+	}
+
+private:
+	const std::vector<uint8_t>& m_bytes;
+	Tracer::Encoding            m_encoding;
+	size_t                      m_position{};
+};
+
+void
+writeUint32(std::ostream& stream, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		stream.put(static_cast<char>(value >> (8 * i)));
+	}
+}
+
+uint32_t
+readUint32(std::istream& stream)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		int next = stream.get();
+		if (next == std::char_traits<char>::eof())
+		{
+			throw std::runtime_error("trace: truncated file");
+		}
+		value |= static_cast<uint32_t>(static_cast<uint8_t>(next)) << (8 * i);
+	}
+	return value;
+}
+} // namespace
+
+Tracer::Tracer(Encoding encoding, size_t chunks)
+    : m_encoding(encoding)
+    , m_chunks(chunks)
+{
+}
+
+void
+Tracer::record(const Record& record)
+{
+	// Opcode, flags and two bytes of modes, then up to eight 10-byte values.
+	constexpr size_t maxRecordSize = 4 + 8 * 10;
+	if (m_chunks[m_current].size() + maxRecordSize > chunkSize)
+	{
+		m_current = (m_current + 1) % m_chunks.size();
+		m_chunks[m_current].clear();
+		m_nextInstructionPointer = 0;
+	}
+
+	Encoder encoder(m_chunks[m_current], m_encoding);
+	encoder.byte(record.m_opCode);
+	encoder.byte(static_cast<uint8_t>(record.m_numParameters | (record.m_hasWritten << 2)));
+	uint64_t modes = 0;
+	for (int i = 0; i < record.m_numParameters; ++i)
+	{
+		modes |= static_cast<uint64_t>(record.m_modes[i] & 0xf) << (4 * i);
+	}
+	encoder.varint(modes);
+	encoder.value(m_encoding == Encoding::Delta
+	                  ? static_cast<int64_t>(record.m_instructionPointer - m_nextInstructionPointer)
+	                  : static_cast<int64_t>(record.m_instructionPointer));
+	for (int i = 0; i < record.m_numParameters; ++i)
+	{
+		encoder.value(record.m_parameters[i]);
+		encoder.value(record.m_operands[i]);
+	}
+	if (record.m_hasWritten)
+	{
+		encoder.value(record.m_written);
+	}
+	m_nextInstructionPointer = record.m_instructionPointer + 1 + record.m_numParameters;
+}
+
+void
+Tracer::halted() const
+{
+	static std::mutex mutex;
+
+	const char* variable = std::getenv("INTCODE_TRACE_OUTPUT");
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ofstream file(variable ? variable : "intcode-trace.bin",
+	                   std::ios::app | std::ios::binary);
+	write(file);
+}
+
+void
+Tracer::write(std::ostream& stream) const
+{
+	stream.write(magic, sizeof(magic));
+	stream.put(static_cast<char>(version));
+	stream.put(static_cast<char>(m_encoding));
+	writeUint32(stream, static_cast<uint32_t>(m_chunks.size()));
+	for (size_t i = 1; i <= m_chunks.size(); ++i)
+	{
+		const auto& chunk = m_chunks[(m_current + i) % m_chunks.size()];
+		writeUint32(stream, static_cast<uint32_t>(chunk.size()));
+		stream.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+}
+
+size_t
+Tracer::read(std::istream& stream, const std::function<void(const Record&)>& visit)
+{
+	size_t traces = 0;
+	char   header[sizeof(magic)];
+	while (stream.read(header, sizeof(header)))
+	{
+		if (std::memcmp(header, magic, sizeof(magic)) != 0)
+		{
+			throw std::runtime_error("trace: bad magic");
+		}
+		if (stream.get() != version)
+		{
+			throw std::runtime_error("trace: unsupported version");
+		}
+		auto     encoding = static_cast<Encoding>(stream.get());
+		uint32_t chunks   = readUint32(stream);
+		for (uint32_t chunk = 0; chunk < chunks; ++chunk)
+		{
+			std::vector<uint8_t> bytes(readUint32(stream));
+			if (!stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size()))
+			{
+				throw std::runtime_error("trace: truncated chunk");
+			}
+
+			Decoder  decoder(bytes, encoding);
+			uint64_t nextInstructionPointer = 0;
+			while (!decoder.done())
+			{
+				Record record;
+				record.m_opCode        = decoder.byte();
+				uint8_t flags          = decoder.byte();
+				record.m_numParameters = flags & 3;
+				record.m_hasWritten    = flags & 4;
+				uint64_t modes         = decoder.varint();
+				int64_t  pointer       = decoder.value();
+				record.m_instructionPointer =
+				    encoding == Encoding::Delta ? nextInstructionPointer + pointer : pointer;
+				for (int i = 0; i < record.m_numParameters; ++i)
+				{
+					record.m_modes[i]      = (modes >> (4 * i)) & 0xf;
+					record.m_parameters[i] = decoder.value();
+					record.m_operands[i]   = decoder.value();
+				}
+				if (record.m_hasWritten)
+				{
+					record.m_written = decoder.value();
+				}
+				nextInstructionPointer = record.m_instructionPointer + 1 + record.m_numParameters;
+				visit(record);
+			}
+		}
+		++traces;
+	}
+	return traces;
+}
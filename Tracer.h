@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+// Binary execution trace of one machine. Built into Runtime when the
+// library is compiled with INTCODE_TRACE; every executed instruction is
+// appended as a compact record to a ring of fixed-size chunks, so a long
+// run keeps its most recent chunkSize * chunks bytes of history. When the
+// machine halts the trace is appended to INTCODE_TRACE_OUTPUT (default
+// intcode-trace.bin); IntcodeTrace decodes it offline.
+//
+// Delta encoding stores the instruction pointer as the distance from where
+// straight-line execution would have continued, and every value as a
+// zigzag varint, so a typical record takes a handful of bytes. Fixed
+// encoding stores full 64-bit fields. Each chunk starts afresh, so dropping
+// the oldest chunk never breaks decoding. Words wider than 64 bits are
+// truncated.
+class Tracer
+{
+public:
+	static constexpr bool   enabled       = true;
+	static constexpr size_t chunkSize     = size_t{1} << 16;
+	static constexpr size_t defaultChunks = 256;
+
+	enum class Encoding : uint8_t
+	{
+		Fixed,
+		Delta
+	};
+
+	// Operands hold the value read for each input parameter and the
+	// resolved address for the parameter written, if any.
+	struct Record
+	{
+		uint64_t               m_instructionPointer{};
+		uint8_t                m_opCode{};
+		uint8_t                m_numParameters{};
+		std::array<int64_t, 3> m_parameters{};
+		std::array<uint8_t, 3> m_modes{};
+		std::array<int64_t, 3> m_operands{};
+		bool                   m_hasWritten{};
+		int64_t                m_written{};
+	};
+
+	explicit Tracer(Encoding encoding = Encoding::Delta, size_t chunks = defaultChunks);
+
+	void record(const Record& record);
+	// Appends the trace to the output file.
+	void halted() const;
+
+	// Oldest record first.
+	void write(std::ostream& stream) const;
+	// Calls visit for each record of every trace in the stream, in order,
+	// and returns the number of traces read; throws std::runtime_error on a
+	// malformed stream.
+	static size_t read(std::istream& stream, const std::function<void(const Record&)>& visit);
+
+private:
+	Encoding                          m_encoding;
+	std::vector<std::vector<uint8_t>> m_chunks;
+	size_t                            m_current{};
+	uint64_t                          m_nextInstructionPointer{};
+};
+
+// Stand-in when tracing is compiled out.
+class NullTracer
+{
+public:
+	static constexpr bool enabled = false;
+
+	using Record = Tracer::Record;
+
+	void record(const Record&) {}
+	void halted() const {}
+};
+
+#if defined(INTCODE_TRACE)
+using RuntimeTracer = Tracer;
+#else
+using RuntimeTracer = NullTracer;
+#endif
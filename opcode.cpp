@@ -1,11 +1,15 @@
-﻿#include <algorithm>
+﻿#include "BatchRuntime.h"
+#include "Sweep.h"
+#include "Symbolic.h"
+
+#include <algorithm>
 #include <numeric>
 #include <vector>
 #include <iostream>
-#include <cassert>
+#include <optional>
 
 int desiredOutput = 19690720;
-std::vector<int> initialCode =
+Program initialCode =
  {  1, -1, -1,3,
     1,1,2,3,
     1,3,4,3,
@@ -42,47 +46,50 @@ std::vector<int> initialCode =
     99,
     2,0,14,0};
 
-int getOutput(std::vector<int> code, int noun, int verb)
+// Runs every verb for one noun side by side, one batch lane per verb.
+std::optional<int> findVerb(int noun)
 {
-    code[1] = noun;
-    code[2] = verb;
-    auto it = code.begin();
-    while (it < code.end())
+    constexpr int verbs = 99;
+    BatchRuntime batch(initialCode, verbs);
+    for (int verb = 0; verb < verbs; ++verb)
     {
-        int opCode = *it++;
-        int argA = *it++;
-        int argB = *it++;
-        int dst = *it++;
-        if (opCode == 1)
-        {
-            code[dst] = code[argA] + code[argB];
-        }
-        else if (opCode == 2)
-        {
-            code[dst] = code[argA] * code[argB];
-        }
-        else if ( opCode == 99 )
-        {
-            break;
-        }
-        else
+        batch.write(verb, 1, noun);
+        batch.write(verb, 2, verb);
+    }
+    batch.run();
+    for (int verb = 0; verb < verbs; ++verb)
+    {
+        if (batch.read(verb, 0) == desiredOutput)
         {
-            assert(false);
+            return verb;
         }
     }
-    return code[0];
+    return {};
 }
+
+// Solves for the noun and verb directly from code[0] as a polynomial in
+// them; searches every pair concretely if the program is not symbolic.
 int main()
 {
-    for (int noun = 0 ; noun < 99 ; ++noun)
+    const ProgramValue variables[] = {1, 2};
+    const ProgramValue results[] = {0};
+    const ProgramValue domains[] = {99, 99};
+    if (auto output = evaluateSymbolically(initialCode, variables, results))
     {
-        for (int verb = 0 ; verb < 99 ; ++verb)
+        if (auto inputs = solve(output->front(), desiredOutput, domains))
         {
-            if ( desiredOutput == getOutput(initialCode, noun, verb))
-            {
-                std::cout << 100 * noun + verb;
-                return 0;
-            }
+            std::cout << 100 * (*inputs)[0] + (*inputs)[1];
         }
+        return 0;
+    }
+
+    WorkStealingPool pool;
+    auto noun = sweep::firstMatch(
+        pool, 99,
+        [](size_t index) { return int(index); },
+        [](int noun) { return findVerb(noun).has_value(); });
+    if (noun)
+    {
+        std::cout << 100 * *noun + *findVerb(*noun);
     }
 }
\ No newline at end of file